@@ -46,7 +46,12 @@
 #ifdef WINDOWS_API
 #include <time.h>
 #else
+#include <time.h>
 #include <sys/time.h>
+#include <fcntl.h>
+#ifdef LINUX_API
+#include <sys/eventfd.h>
+#endif
 #endif
 
 static YRETCODE  yapiUpdateDeviceList_internal(u32 forceupdate, char *errmsg);
@@ -226,9 +231,363 @@ static write_timedcb_onfile(YAPI_FUNCTION fundescr, double deviceTime, const u8
 #endif
 
 
-void yFunctionUpdate(YAPI_FUNCTION fundescr, const char *value)
+/*****************************************************************************
+  Pollable event file descriptor
+ ****************************************************************************/
+
+// Wake up yapiSleep and the application event loop (see yapiGetEventFd)
+// when something must be handled by yapiHandleEvents
+void ySignalEvents(void)
+{
+    if (yContext == NULL) {
+        return;
+    }
+#ifndef WINDOWS_API
+    // only one write until the next yapiHandleEvents
+    if (yContext->eventFdWrite >= 0 && yAtomicCAS32(&yContext->eventFdSignaled, 0, 1)) {
+#ifdef LINUX_API
+        u64 one = 1;
+        if (write(yContext->eventFdWrite, &one, sizeof(one)) < 0) {
+#else
+        u8 one = 1;
+        if (write(yContext->eventFdWrite, &one, 1) < 0) {
+#endif
+            // already readable: nothing to do
+        }
+    }
+#endif
+    ySetEvent(&yContext->exitSleepEvent);
+}
+
+static void yEventFdDrain(void)
+{
+#ifndef WINDOWS_API
+    u8  buffer[64];
+
+    if (yContext->eventFdRead < 0) {
+        return;
+    }
+    // empty the descriptor before clearing the flag: an event signaled in
+    // between is handled by the caller, and the next one writes again
+    while (read(yContext->eventFdRead, buffer, sizeof(buffer)) > 0);
+    yAtomicStore32(&yContext->eventFdSignaled, 0);
+#endif
+}
+
+static void yEventFdClose(yContextSt *ctx)
+{
+#ifndef WINDOWS_API
+    if (ctx->eventFdRead >= 0) {
+        close(ctx->eventFdRead);
+        if (ctx->eventFdWrite != ctx->eventFdRead) {
+            close(ctx->eventFdWrite);
+        }
+    }
+    ctx->eventFdRead = -1;
+    ctx->eventFdWrite = -1;
+#endif
+}
+
+
+/*****************************************************************************
+  Function callback events
+ ****************************************************************************/
+
+static int ycbqueuemode = YAPI_EVQUEUE_NONE;
+static u32 ycbqueuesize = 0;
+static int ycbthreads = 0;
+
+// configuration of the library threads, per role (see yapiSetThreadConfig)
+typedef struct {
+    u64     cpumask;
+    int     priority;
+} yThreadRoleCfg;
+static yThreadRoleCfg ythreadcfg[YAPI_THREAD_ROLES];
+static const char *ythreadnames[YAPI_THREAD_ROLES] = {
+    "yapi-usb", "yapi-hub", "yapi-callback", "yapi-ssdp", "yapi-firmware"
+};
+
+void yThreadApplyRole(int role)
+{
+    if (yThreadSetup(ythreadnames[role], ythreadcfg[role].cpumask, ythreadcfg[role].priority) < 0) {
+        dbglog("Unable to apply CPU affinity or priority to %s thread\n", ythreadnames[role]);
+    }
+}
+
+#define YCBEV_DEFAULT_SIZE  256
+
+static void yCbEventDispatch(const yCbEvent *ev);
+static void yCbShardDispatch(yCbShard *shard);
+
+static u32 yFunFilterFlush(void);//forward declaration
+
+static void* yCbThread(void *ctx)
+{
+    yThread     *thread = (yThread*)ctx;
+    yCbShard    *shard = (yCbShard*)thread->ctx;
+    u32         timeout = 100;
+
+    yThreadApplyRole(YAPI_THREAD_CALLBACK);
+    yThreadSignalStart(thread);
+    while (!yThreadMustEnd(thread)) {
+        yWaitForEvent(&shard->wakeup, (int)timeout);
+        yCbShardDispatch(shard);
+        if (shard == &yContext->cbShards[0]) {
+            // the first callback thread also delivers the values held back
+            // by function value filters, as soon as they are due
+            timeout = yFunFilterFlush();
+            if (timeout > 100) timeout = 100;
+        }
+    }
+    yThreadSignalEnd(thread);
+    return NULL;
+}
+
+static void yCbQueueInit(yContextSt *ctx)
+{
+    int i;
+    u32 size = ycbqueuesize;
+
+    ctx->cbQueuePolicy = ycbqueuemode;
+    if (ycbthreads > 0 && ycbqueuemode == YAPI_EVQUEUE_NONE) {
+        // callback threads always need a queue
+        ctx->cbQueuePolicy = YAPI_EVQUEUE_DROP_OLDEST;
+    }
+    if (ctx->cbQueuePolicy == YAPI_EVQUEUE_NONE) {
+        return;
+    }
+    if (size == 0) {
+        size = YCBEV_DEFAULT_SIZE;
+    }
+    ctx->cbNbThreads = ycbthreads;
+    ctx->cbNbShards = (ycbthreads > 0 ? ycbthreads : 1);
+    ctx->cbShards = (yCbShard*) yMalloc(ctx->cbNbShards * sizeof(yCbShard));
+    memset(ctx->cbShards, 0, ctx->cbNbShards * sizeof(yCbShard));
+    yInitializeRWLock(&ctx->cbThreadsLock);
+    for (i = 0; i < ctx->cbNbShards; i++) {
+        yCbShard *shard = &ctx->cbShards[i];
+        yLFQueueInit(&shard->queue, sizeof(yCbEvent), size);
+        yInitializeCriticalSection(&shard->latest_cs);
+        if (ctx->cbQueuePolicy == YAPI_EVQUEUE_LATEST_VALUE) {
+            shard->latest = (yCbEvent*) yMalloc(YCBEV_LATEST_SIZE * sizeof(yCbEvent));
+            shard->latestSpare = (yCbEvent*) yMalloc(YCBEV_LATEST_SIZE * sizeof(yCbEvent));
+            memset(shard->latest, 0, YCBEV_LATEST_SIZE * sizeof(yCbEvent));
+            memset(shard->latestSpare, 0, YCBEV_LATEST_SIZE * sizeof(yCbEvent));
+        }
+        yCreateEvent(&shard->wakeup);
+    }
+}
+
+// must be called with yContext set, since callback threads use it
+static void yCbQueueStartThreads(yContextSt *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->cbNbThreads; i++) {
+        if (yThreadCreate(&ctx->cbShards[i].thread, yCbThread, &ctx->cbShards[i]) < 0) {
+            dbglog("Unable to start callback thread %d\n", i);
+        }
+    }
+}
+
+// callbacks may still use the API: stop the threads before tearing it down
+static void yCbQueueStopThreads(yContextSt *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->cbNbThreads; i++) {
+        yCbShard *shard = &ctx->cbShards[i];
+        if (yThreadIsRunning(&shard->thread)) {
+            u64 timeref = yapiGetTickCount();
+            yThreadRequestEnd(&shard->thread);
+            ySetEvent(&shard->wakeup);
+            while (yThreadIsRunning(&shard->thread) && (yapiGetTickCount() - timeref < 1000)) {
+                yApproximateSleep(10);
+            }
+            yThreadKill(&shard->thread);
+        }
+    }
+}
+
+// must be called once the I/O threads are stopped
+static void yCbQueueFree(yContextSt *ctx)
+{
+    int i;
+
+    if (ctx->cbQueuePolicy == YAPI_EVQUEUE_NONE) {
+        return;
+    }
+    for (i = 0; i < ctx->cbNbShards; i++) {
+        yCbShard *shard = &ctx->cbShards[i];
+        yCloseEvent(&shard->wakeup);
+        yLFQueueCleanup(&shard->queue);
+        yDeleteCriticalSection(&shard->latest_cs);
+        if (shard->latest) {
+            yFree(shard->latest);
+            yFree(shard->latestSpare);
+        }
+    }
+    yDeleteRWLock(&ctx->cbThreadsLock);
+    yFree(ctx->cbShards);
+    ctx->cbNbShards = 0;
+    ctx->cbNbThreads = 0;
+    ctx->cbQueuePolicy = YAPI_EVQUEUE_NONE;
+}
+
+// Store a value into the latest value table, replacing any pending value of
+// the same function. Returns 0 if the table is full.
+static int yCbLatestPut(yCbShard *shard, u32 hash, const yCbEvent *ev)
+{
+    u32 i, slot;
+    int res = 0;
+
+    slot = (hash >> 16) & (YCBEV_LATEST_SIZE - 1);
+    yEnterCriticalSection(&shard->latest_cs);
+    for (i = 0; i < YCBEV_LATEST_SIZE; i++, slot = (slot + 1) & (YCBEV_LATEST_SIZE - 1)) {
+        yCbEvent *entry = &shard->latest[slot];
+        if (entry->type == 0) {
+            yAtomicAdd32(&shard->latestCount, 1);
+        } else if (entry->fundesc == ev->fundesc && entry->type == ev->type) {
+            // string and numeric values of a function are kept apart
+            yAtomicAdd32(&yContext->cbNbCoalesced, 1);
+        } else {
+            continue;
+        }
+        memcpy(entry, ev, sizeof(yCbEvent));
+        res = 1;
+        break;
+    }
+    yLeaveCriticalSection(&shard->latest_cs);
+    return res;
+}
+
+// Called by the I/O threads: never blocks on the user callbacks. All events
+// of a function go to the same shard, so that they are delivered in order.
+static void yCbQueuePush(const yCbEvent *ev)
+{
+    u32         hash = (u32)ev->fundesc * 2654435761u;
+    yCbShard    *shard = &yContext->cbShards[(hash >> 24) % yContext->cbNbShards];
+    int         coalesce;
+
+    yAtomicAdd32(&yContext->cbNbQueued, 1);
+    if (yContext->cbQueuePolicy == YAPI_EVQUEUE_LATEST_VALUE) {
+        coalesce = (ev->type == YCBEV_VALUE || ev->type == YCBEV_NUMERIC);
+        // once values have overflowed, keep coalescing them until the table
+        // is dispatched so that a function never goes back in time
+        if (coalesce && yAtomicLoad32(&shard->latestCount) > 0) {
+            if (!yCbLatestPut(shard, hash, ev)) {
+                yAtomicAdd32(&yContext->cbNbDropped, 1);
+            }
+        } else if (!yPushLFQueue(&shard->queue, ev)) {
+            if (!coalesce || !yCbLatestPut(shard, hash, ev)) {
+                yAtomicAdd32(&yContext->cbNbDropped, 1);
+            }
+        }
+    } else {
+        int dropped = yForceLFQueue(&shard->queue, ev);
+        if (dropped) {
+            yAtomicAdd32(&yContext->cbNbDropped, dropped);
+        }
+    }
+    if (yContext->cbNbThreads > 0) {
+        ySetEvent(&shard->wakeup);
+    } else {
+        ySignalEvents();
+    }
+}
+
+static void yCbEventDispatch(const yCbEvent *ev)
+{
+    // callback threads run in parallel, but not while the application
+    // holds yapiLockFunctionCallBack
+    if (yContext->cbNbThreads > 0) {
+        yEnterReadLock(&yContext->cbThreadsLock);
+    } else {
+        yEnterCriticalSection(&yContext->functionCallbackCS);
+    }
+    switch (ev->type) {
+    case YCBEV_VALUE:
+    case YCBEV_NAME:
+        if (yContext->functionCallback) {
+            yContext->functionCallback(ev->fundesc, ev->type == YCBEV_NAME ? NULL : ev->value);
+        }
+        break;
+    case YCBEV_NUMERIC:
+        if (yContext->functionNumericCallback) {
+            yContext->functionNumericCallback(ev->fundesc, ev->len, ev->numeric, ev->timestamp);
+        }
+        break;
+    case YCBEV_TIMED:
+        if (yContext->timedReportCallback) {
+            yContext->timedReportCallback(ev->fundesc, ev->report.deviceTime, ev->report.bytes, ev->len);
+        }
+        if (yContext->timedReportExCallback) {
+            yContext->timedReportExCallback(ev->fundesc, ev->report.deviceTime, ev->report.hostTime, ev->report.bytes, ev->len);
+        }
+        break;
+    }
+    if (yContext->cbNbThreads > 0) {
+        yLeaveReadLock(&yContext->cbThreadsLock);
+    } else {
+        yLeaveCriticalSection(&yContext->functionCallbackCS);
+    }
+}
+
+// Invoke the callbacks of all pending events of a shard. Each shard has a
+// single consumer: its callback thread, or the thread holding handleEv_cs.
+static void yCbShardDispatch(yCbShard *shard)
+{
+    yCbEvent    ev;
+    yCbEvent    *latest;
+    u32         i, count;
+
+    // do not loop forever if events keep coming
+    count = shard->queue.mask + 1;
+    while (count-- > 0 && yPopLFQueue(&shard->queue, &ev)) {
+        yCbEventDispatch(&ev);
+    }
+    if (shard->latest == NULL || yAtomicLoad32(&shard->latestCount) == 0) {
+        return;
+    }
+    yEnterCriticalSection(&shard->latest_cs);
+    latest = shard->latest;
+    shard->latest = shard->latestSpare;
+    shard->latestSpare = latest;
+    yAtomicStore32(&shard->latestCount, 0);
+    yLeaveCriticalSection(&shard->latest_cs);
+    for (i = 0; i < YCBEV_LATEST_SIZE; i++) {
+        if (latest[i].type) {
+            yCbEventDispatch(&latest[i]);
+            latest[i].type = 0;
+        }
+    }
+}
+
+// Called from yapiHandleEvents, unless callback threads are used
+static void yCbQueueDispatch(void)
+{
+    if (yContext->cbQueuePolicy == YAPI_EVQUEUE_NONE || yContext->cbNbThreads > 0) {
+        return;
+    }
+    yCbShardDispatch(&yContext->cbShards[0]);
+}
+
+
+static void yFunctionStringDeliver(YAPI_FUNCTION fundescr, const char *value)
 {
     if(yContext->functionCallback) {
+        if (yContext->cbQueuePolicy != YAPI_EVQUEUE_NONE) {
+            yCbEvent ev;
+            ev.type = (value ? YCBEV_VALUE : YCBEV_NAME);
+            ev.len = 0;
+            ev.fundesc = fundescr;
+            ev.timestamp = yapiGetTickCount();
+            if (value) {
+                YSTRNCPY(ev.value, YOCTO_PUBVAL_LEN, value, YOCTO_PUBVAL_LEN - 1);
+            }
+            yCbQueuePush(&ev);
+            return;
+        }
         yEnterCriticalSection(&yContext->functionCallbackCS);
 #ifdef DEBUG_CALLBACK
         write_cb_onfile(fundescr, value);
@@ -238,14 +597,319 @@ void yFunctionUpdate(YAPI_FUNCTION fundescr, const char *value)
     }
 }
 
-void yFunctionTimedUpdate(YAPI_FUNCTION fundescr, double deviceTime, const u8 *report, u32 len)
+// Forward a value to the numeric callback, if any, when it is a number
+static void yFunctionNumericDeliver(YAPI_FUNCTION fundescr, Notification_funydx funInfo, const char *funcval)
 {
-    if(yContext->timedReportCallback) {
+    double  value;
+    int     valueType;
+
+    if(!yContext->functionNumericCallback) {
+        return;
+    }
+    valueType = decodePubValNumeric(funInfo, funcval, &value);
+    if(valueType < 0) {
+        return;
+    }
+    if (yContext->cbQueuePolicy != YAPI_EVQUEUE_NONE) {
+        yCbEvent ev;
+        ev.type = YCBEV_NUMERIC;
+        ev.len = (u8)valueType;
+        ev.fundesc = fundescr;
+        ev.timestamp = yapiGetTickCount();
+        ev.numeric = value;
+        yCbQueuePush(&ev);
+        return;
+    }
+    yEnterCriticalSection(&yContext->functionCallbackCS);
+    if(yContext->functionNumericCallback) {
+        yContext->functionNumericCallback(fundescr, valueType, value, yapiGetTickCount());
+    }
+    yLeaveCriticalSection(&yContext->functionCallbackCS);
+}
+
+// Both callbacks receive every value: the numeric callback gets the numbers it
+// can decode, and the value is only formatted if a string callback is registered
+static void yFunctionRawDeliver(YAPI_FUNCTION fundescr, Notification_funydx funInfo, const char *funcval)
+{
+    yFunctionNumericDeliver(fundescr, funInfo, funcval);
+    if (yContext->functionCallback) {
+        char buffer[YOCTO_PUBVAL_LEN];
+        decodePubVal(funInfo, funcval, buffer);
+        yFunctionStringDeliver(fundescr, buffer);
+    }
+}
+
+
+/*****************************************************************************
+  Per-function value filters
+ ****************************************************************************/
+
+static u32 yFunFilterHome(YAPI_FUNCTION fundescr)
+{
+    return ((u32)fundescr * 2654435761u >> 16) & (YFUNFILTER_SIZE - 1);
+}
+
+static yFunFilter* yFunFilterFind(YAPI_FUNCTION fundescr, int create)
+{
+    u32 i, slot;
+
+    slot = yFunFilterHome(fundescr);
+    for (i = 0; i < YFUNFILTER_SIZE; i++, slot = (slot + 1) & (YFUNFILTER_SIZE - 1)) {
+        yFunFilter *f = &yContext->funFilters[slot];
+        if (f->fundesc == fundescr) {
+            return f;
+        }
+        if (f->fundesc == 0) {
+            if (!create) {
+                return NULL;
+            }
+            memset(f, 0, sizeof(yFunFilter));
+            f->fundesc = fundescr;
+            return f;
+        }
+    }
+    return NULL;
+}
+
+// Free a filter slot, moving back the entries that follow it in the probe
+// sequence so that yFunFilterFind never stops on the hole
+static void yFunFilterRelease(u32 slot)
+{
+    u32 next, home;
+
+    for (;;) {
+        yContext->funFilters[slot].fundesc = 0;
+        next = slot;
+        for (;;) {
+            next = (next + 1) & (YFUNFILTER_SIZE - 1);
+            if (yContext->funFilters[next].fundesc == 0) {
+                return;
+            }
+            home = yFunFilterHome(yContext->funFilters[next].fundesc);
+            // the entry can fill the hole unless its home is between the hole and itself
+            if (((next - home) & (YFUNFILTER_SIZE - 1)) >= ((next - slot) & (YFUNFILTER_SIZE - 1))) {
+                break;
+            }
+        }
+        memcpy(&yContext->funFilters[slot], &yContext->funFilters[next], sizeof(yFunFilter));
+        slot = next;
+    }
+}
+
+// Make the first callback thread recompute its timeout for yFunFilterFlush
+static void yFunFilterWakeup(void)
+{
+    if (yContext->cbNbThreads > 0) {
+        ySetEvent(&yContext->cbShards[0].wakeup);
+    }
+}
+
+// Get the numeric value of a notification, for the deadband. Returns 0 if
+// the value is not numeric.
+static int yFunFilterNumeric(int kind, Notification_funydx funInfo, const char *value, double *numval)
+{
+    char    buffer[YOCTO_PUBVAL_LEN];
+    char    *end;
+
+    if (kind == YFUNFILTER_RAW) {
+        if (decodePubValNumeric(funInfo, value, numval) >= 0) {
+            return 1;
+        }
+        decodePubVal(funInfo, value, buffer);
+        value = buffer;
+    }
+    *numval = strtod(value, &end);
+    return (end != value);
+}
+
+// Returns 1 if the value must be delivered right away, or 0 if it has been
+// held back (minimum interval) or dropped (deadband).
+static int yFunFilterAccept(YAPI_FUNCTION fundescr, int kind, Notification_funydx funInfo, const char *value)
+{
+    yFunFilter  *f;
+    double      numval = 0;
+    int         hasnum = 0;
+    int         res = 1;
+    int         wakeup = 0;
+    u64         now;
+
+    if (yAtomicLoad32(&yContext->funFilterCount) == 0) {
+        return 1;
+    }
+    yEnterCriticalSection(&yContext->funFilter_cs);
+    f = yFunFilterFind(fundescr, 0);
+    if (f && (f->minInterval > 0 || f->deadband > 0)) {
+        if (f->deadband > 0) {
+            hasnum = yFunFilterNumeric(kind, funInfo, value, &numval);
+        }
+        if (hasnum && f->hasLastValue &&
+            (numval > f->lastValue ? numval - f->lastValue : f->lastValue - numval) < f->deadband) {
+            // back within the deadband: a value held back is now obsolete
+            if (f->pending) {
+                f->pending = 0;
+                yAtomicAdd32(&yContext->funFilterPending, -1);
+            }
+            res = 0;
+        } else {
+            now = yapiGetTickCount();
+            if (f->minInterval > 0 && f->hasLastTime && now - f->lastTime < f->minInterval) {
+                // latest value wins
+                if (f->pending) {
+                    yAtomicAdd32(&yContext->cbNbCoalesced, 1);
+                } else {
+                    yAtomicAdd32(&yContext->funFilterPending, 1);
+                    wakeup = 1;
+                }
+                f->pending = (u8)kind;
+                f->pendingHasValue = (u8)hasnum;
+                f->pendingValue = numval;
+                f->funInfo = funInfo;
+                if (kind == YFUNFILTER_RAW) {
+                    memcpy(f->value, value, YOCTO_PUBVAL_SIZE);
+                } else {
+                    YSTRNCPY(f->value, YOCTO_PUBVAL_LEN, value, YOCTO_PUBVAL_LEN - 1);
+                }
+                res = 0;
+            } else {
+                f->lastTime = now;
+                f->hasLastTime = 1;
+                if (hasnum) {
+                    f->lastValue = numval;
+                    f->hasLastValue = 1;
+                }
+                if (f->pending) {
+                    f->pending = 0;
+                    yAtomicAdd32(&yContext->funFilterPending, -1);
+                }
+            }
+        }
+    }
+    yLeaveCriticalSection(&yContext->funFilter_cs);
+    if (wakeup) {
+        yFunFilterWakeup();
+    }
+    return res;
+}
+
+// Deliver the values held back whose minimum interval has elapsed. Called
+// from yapiHandleEvents and by the first callback thread. Returns the delay
+// in ms until the next held back value is due, or YFUNFILTER_IDLE.
+static u32 yFunFilterFlush(void)
+{
+    yFunFilter  due[16];
+    int         i, nbdue;
+    u32         slot, next;
+    u64         now;
+
+    if (yAtomicLoad32(&yContext->funFilterPending) == 0) {
+        return YFUNFILTER_IDLE;
+    }
+    do {
+        nbdue = 0;
+        next = YFUNFILTER_IDLE;
+        now = yapiGetTickCount();
+        yEnterCriticalSection(&yContext->funFilter_cs);
+        slot = 0;
+        while (slot < YFUNFILTER_SIZE && nbdue < 16) {
+            yFunFilter *f = &yContext->funFilters[slot];
+            if (!f->pending) {
+                slot++;
+                continue;
+            }
+            if (now - f->lastTime < f->minInterval) {
+                if (f->lastTime + f->minInterval - now < next) {
+                    next = (u32)(f->lastTime + f->minInterval - now);
+                }
+                slot++;
+                continue;
+            }
+            memcpy(&due[nbdue++], f, sizeof(yFunFilter));
+            f->lastTime = now;
+            if (f->pendingHasValue) {
+                f->lastValue = f->pendingValue;
+                f->hasLastValue = 1;
+            }
+            f->pending = 0;
+            yAtomicAdd32(&yContext->funFilterPending, -1);
+            if (f->minInterval == 0 && f->deadband == 0) {
+                // filter removed while a value was held back, another
+                // entry may be moved to this slot
+                yFunFilterRelease(slot);
+                continue;
+            }
+            slot++;
+        }
+        yLeaveCriticalSection(&yContext->funFilter_cs);
+        for (i = 0; i < nbdue; i++) {
+            if (due[i].pending == YFUNFILTER_RAW) {
+                yFunctionRawDeliver(due[i].fundesc, due[i].funInfo, due[i].value);
+            } else {
+                yFunctionStringDeliver(due[i].fundesc, due[i].value);
+            }
+        }
+    } while (nbdue == 16);
+    return next;
+}
+
+static void yFunFilterFree(yContextSt *ctx)
+{
+    if (ctx->funFilters) {
+        yFree(ctx->funFilters);
+        ctx->funFilters = NULL;
+    }
+    ctx->funFilterCount = 0;
+    ctx->funFilterPending = 0;
+}
+
+
+void yFunctionUpdate(YAPI_FUNCTION fundescr, const char *value)
+{
+    Notification_funydx funInfo;
+
+    if (value) {
+        funInfo.raw = 0;
+        if (!yFunFilterAccept(fundescr, YFUNFILTER_STR, funInfo, value)) {
+            return;
+        }
+    }
+    yFunctionStringDeliver(fundescr, value);
+}
+
+// Forward a value received as a raw notification payload
+void yFunctionValueUpdate(YAPI_FUNCTION fundescr, Notification_funydx funInfo, const char *funcval)
+{
+    if (yFunFilterAccept(fundescr, YFUNFILTER_RAW, funInfo, funcval)) {
+        yFunctionRawDeliver(fundescr, funInfo, funcval);
+    }
+}
+
+void yFunctionTimedUpdate(YAPI_FUNCTION fundescr, double deviceTime, double hostTime, const u8 *report, u32 len)
+{
+    ypSetTimedReportTime(fundescr, deviceTime);
+    if(yContext->timedReportCallback || yContext->timedReportExCallback) {
+        if (yContext->cbQueuePolicy != YAPI_EVQUEUE_NONE) {
+            yCbEvent ev;
+            YASSERT(len <= YCBEV_MAX_REPORT);
+            ev.type = YCBEV_TIMED;
+            ev.len = (u8)(len <= YCBEV_MAX_REPORT ? len : YCBEV_MAX_REPORT);
+            ev.fundesc = fundescr;
+            ev.timestamp = yapiGetTickCount();
+            ev.report.deviceTime = deviceTime;
+            ev.report.hostTime = hostTime;
+            memcpy(ev.report.bytes, report, ev.len);
+            yCbQueuePush(&ev);
+            return;
+        }
         yEnterCriticalSection(&yContext->functionCallbackCS);
 #ifdef DEBUG_CALLBACK
         write_timedcb_onfile(fundescr, deviceTime, report, len);
 #endif
-        yContext->timedReportCallback(fundescr, deviceTime, report, len);
+        if(yContext->timedReportCallback) {
+            yContext->timedReportCallback(fundescr, deviceTime, report, len);
+        }
+        if(yContext->timedReportExCallback) {
+            yContext->timedReportExCallback(fundescr, deviceTime, hostTime, report, len);
+        }
         yLeaveCriticalSection(&yContext->functionCallbackCS);
     }
 }
@@ -347,6 +1011,7 @@ typedef struct {
     };
     int     nbKnownDevices;
     yStrRef *knownDevices;
+    yStrRef *enumSerials;   // serial enumerated for each hub devYdx, or NULL
 }ENU_CONTEXT;
 
 
@@ -392,8 +1057,12 @@ static int wpSafeCheckOverwrite(yUrlRef registeredUrl, HubSt *hub, yUrlRef devUr
 void initDevYdxInfos(int devYdx, yStrRef serial)
 {
     yGenericDeviceSt *gen = yContext->generic_infos + devYdx;
+    u32 queued;
     yEnterCriticalSection(&yContext->generic_cs);
+    // the devYdx may still be in the pending log queue
+    queued = gen->flags & DEVGEN_LOG_QUEUED;
     memset(gen,0, sizeof(yGenericDeviceSt));
+    gen->flags = queued;
     gen->serial = serial;
     yLeaveCriticalSection(&yContext->generic_cs);
 }
@@ -406,6 +1075,100 @@ void freeDevYdxInfos(int devYdx)
     yLeaveCriticalSection(&yContext->generic_cs);
 }
 
+// Least-squares fit of the lowest offset of each bucket
+static void yClockModelFit(yClockModel *clk)
+{
+    double  sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double  n = 0, den;
+    u32     i;
+
+    for (i = 0; i < YCLOCK_NB_BUCKETS; i++) {
+        if (clk->bucketNum[i] == 0 || clk->lastBucket - clk->bucketNum[i] >= YCLOCK_NB_BUCKETS) {
+            continue;   // unused or outdated bucket
+        }
+        n++;
+        sx += clk->bucketDev[i];
+        sy += clk->bucketOfs[i];
+        sxx += clk->bucketDev[i] * clk->bucketDev[i];
+        sxy += clk->bucketDev[i] * clk->bucketOfs[i];
+    }
+    den = n * sxx - sx * sx;
+    // keep the previous drift until buckets span at least one bucket length
+    if (n >= 2 && den > n * n * YCLOCK_BUCKET_SEC * YCLOCK_BUCKET_SEC / 4) {
+        clk->drift = (n * sxy - sx * sy) / den;
+        if (clk->drift > YCLOCK_MAX_DRIFT) {
+            clk->drift = YCLOCK_MAX_DRIFT;
+        } else if (clk->drift < -YCLOCK_MAX_DRIFT) {
+            clk->drift = -YCLOCK_MAX_DRIFT;
+        }
+    }
+    clk->offset = (sy - clk->drift * sx) / n;
+}
+
+static void yClockModelUpdate(yClockModel *clk, double deviceTime, double hostTime)
+{
+    double  ofs = hostTime - deviceTime;
+    double  rel, err;
+    u32     bucket, slot;
+
+    if (clk->nbSamples > 0) {
+        err = ofs - (clk->offset + clk->drift * (deviceTime - clk->devRef));
+        if (deviceTime < clk->lastDev || err > YCLOCK_RESET_SEC || err < -YCLOCK_RESET_SEC) {
+            // device rebooted, or its clock has been set
+            memset(clk, 0, sizeof(yClockModel));
+        }
+    }
+    if (clk->nbSamples == 0) {
+        clk->devRef = deviceTime;
+    }
+    rel = deviceTime - clk->devRef;
+    bucket = (u32)(rel / YCLOCK_BUCKET_SEC) + 1;    // 0 marks an unused bucket
+    slot = bucket % YCLOCK_NB_BUCKETS;
+    if (clk->bucketNum[slot] != bucket || ofs < clk->bucketOfs[slot]) {
+        clk->bucketNum[slot] = bucket;
+        clk->bucketDev[slot] = rel;
+        clk->bucketOfs[slot] = ofs;
+    }
+    clk->lastBucket = bucket;
+    clk->lastDev = deviceTime;
+    clk->nbSamples++;
+    yClockModelFit(clk);
+}
+
+// Called for each device time packet, with the time at which it was
+// received (in yapiGetTickCountUs() units)
+void yUpdateDeviceTime(int devYdx, double deviceTime, u64 rxtime)
+{
+    yGenericDeviceSt *gen = yContext->generic_infos + devYdx;
+    double hostTime = rxtime / 1000000.0;
+
+    yEnterCriticalSection(&yContext->generic_cs);
+    gen->deviceTime = deviceTime;
+    yClockModelUpdate(&gen->clock, deviceTime, hostTime);
+    yLeaveCriticalSection(&yContext->generic_cs);
+}
+
+// Get the time of the last device time packet, and the matching host time.
+// Returns the number of samples of the clock model: when it is 0, no device
+// time packet has been received and hostTime is set to 0
+int yGetDeviceTime(int devYdx, double *deviceTime, double *hostTime)
+{
+    yGenericDeviceSt *gen = yContext->generic_infos + devYdx;
+    yClockModel *clk = &gen->clock;
+    int nbSamples;
+
+    yEnterCriticalSection(&yContext->generic_cs);
+    *deviceTime = gen->deviceTime;
+    nbSamples = (int)clk->nbSamples;
+    if (nbSamples > 0) {
+        *hostTime = *deviceTime + clk->offset + clk->drift * (*deviceTime - clk->devRef);
+    } else {
+        *hostTime = 0;
+    }
+    yLeaveCriticalSection(&yContext->generic_cs);
+    return nbSamples;
+}
+
 static void logResult(void *context, const u8 *result, u32 resultlen, int retcode, const char *errmsg)
 {
     char buffer[512];
@@ -586,6 +1349,71 @@ YRETCODE yapiPullDeviceLog(const char *serial)
     return yapiPullDeviceLogEx(devydx);
 }
 
+// This function should only be called after seizing generic_cs
+static void yLogQueuePushUnsec(int devydx)
+{
+    yGenericDeviceSt *gen = yContext->generic_infos + devydx;
+
+    if (gen->flags & DEVGEN_LOG_QUEUED) {
+        return;
+    }
+    // each devYdx is queued at most once, the queue cannot overflow
+    YASSERT(yContext->logQueueCount < ALLOC_YDX_PER_HUB);
+    yContext->logQueue[(yContext->logQueueHead + yContext->logQueueCount) % ALLOC_YDX_PER_HUB] = (u8)devydx;
+    yContext->logQueueCount++;
+    gen->flags |= DEVGEN_LOG_QUEUED;
+}
+
+// Called when a network device signals new logs (USB devices are pulled
+// when they become idle). Returns 1 if the logs will be pulled by the hub
+// helper thread, 0 if the device log callback is not active for this device.
+int yNotifyDeviceLog(int devydx)
+{
+    yGenericDeviceSt *gen = yContext->generic_infos + devydx;
+    int res = 0;
+
+    yEnterCriticalSection(&yContext->generic_cs);
+    if (gen->flags & DEVGEN_LOG_ACTIVATED) {
+        gen->flags |= DEVGEN_LOG_PENDING;
+        yLogQueuePushUnsec(devydx);
+        res = 1;
+    }
+    yLeaveCriticalSection(&yContext->generic_cs);
+    return res;
+}
+
+// Pull the logs of the devices that have signaled new logs. A device that
+// cannot be pulled yet (busy) is retried on the next call.
+void yPullPendingDeviceLogs(void)
+{
+    yGenericDeviceSt *gen;
+    int devydx, count;
+
+    yEnterCriticalSection(&yContext->generic_cs);
+    count = yContext->logQueueCount;
+    yLeaveCriticalSection(&yContext->generic_cs);
+    while (count-- > 0) {
+        yEnterCriticalSection(&yContext->generic_cs);
+        if (yContext->logQueueCount == 0) {
+            yLeaveCriticalSection(&yContext->generic_cs);
+            break;
+        }
+        devydx = yContext->logQueue[yContext->logQueueHead];
+        yContext->logQueueHead = (yContext->logQueueHead + 1) % ALLOC_YDX_PER_HUB;
+        yContext->logQueueCount--;
+        yContext->generic_infos[devydx].flags &= ~DEVGEN_LOG_QUEUED;
+        yLeaveCriticalSection(&yContext->generic_cs);
+        yapiPullDeviceLogEx(devydx);
+        yEnterCriticalSection(&yContext->generic_cs);
+        gen = yContext->generic_infos + devydx;
+        if ((gen->flags & (DEVGEN_LOG_ACTIVATED | DEVGEN_LOG_PENDING | DEVGEN_LOG_PULLING)) ==
+            (DEVGEN_LOG_ACTIVATED | DEVGEN_LOG_PENDING)) {
+            yLogQueuePushUnsec(devydx);
+        }
+        yLeaveCriticalSection(&yContext->generic_cs);
+    }
+}
+
 
 
 /*****************************************************************************
@@ -673,6 +1501,9 @@ void wpSafeUpdate(HubSt *hub,u8 devYdx, yStrRef serialref,yStrRef lnameref, yUrl
 {
 
     yUrlRef     registeredUrl =wpGetDeviceUrlRef(serialref);
+    // devices restored from warm-start cache were never announced to the user
+    int         fromCache = wpIsFromCache(serialref);
+    int         res;
 #ifdef DEBUG_WP
     {
         if (hub == NULL){
@@ -696,14 +1527,22 @@ void wpSafeUpdate(HubSt *hub,u8 devYdx, yStrRef serialref,yStrRef lnameref, yUrl
 #endif
         return;
     }
-    if (wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devUrl, beacon)) {
+    res = wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devUrl, beacon);
+    if (res) {
         ypRegister(YSTRREF_MODULE_STRING, serialref, YSTRREF_mODULE_STRING, lnameref, YOCTO_AKA_YFUNCTION, -1, NULL);
         if(hub && devYdx < MAX_YDX_PER_HUB) {
             // Update hub-specific devYdx mapping between enus->devYdx and our wp devYdx
             hub->devYdxMap[devYdx] = wpGetDevYdx(serialref);
         }
         // Forward high-level notification to API user
-        if(yContext->changeCallback){
+        if (res == 2 && fromCache) {
+            // device restored from warm-start cache seen for the first time
+            if (yContext->arrivalCallback) {
+                yEnterCriticalSection(&yContext->deviceCallbackCS);
+                yContext->arrivalCallback(serialref);
+                yLeaveCriticalSection(&yContext->deviceCallbackCS);
+            }
+        } else if(yContext->changeCallback){
             yEnterCriticalSection(&yContext->deviceCallbackCS);
             yContext->changeCallback(serialref);
             yLeaveCriticalSection(&yContext->deviceCallbackCS);
@@ -715,8 +1554,11 @@ void wpSafeUpdate(HubSt *hub,u8 devYdx, yStrRef serialref,yStrRef lnameref, yUrl
 
 void wpSafeUnregister(yStrRef serialref)
 {
+    // devices restored from warm-start cache were never announced to the user
+    int fromCache = wpIsFromCache(serialref);
+
     wpPreventUnregister();
-    if(wpMarkForUnregister(serialref)){
+    if(wpMarkForUnregister(serialref) && !fromCache){
         // Forward high-level notification to API user before deleting data
         if (yContext->removalCallback) {
             yEnterCriticalSection(&yContext->deviceCallbackCS);
@@ -743,6 +1585,9 @@ static void parseNetWpEntry(ENU_CONTEXT *enus)
         }
     }
 
+    if(enus->enumSerials && enus->devYdx < MAX_YDX_PER_HUB) {
+        enus->enumSerials[enus->devYdx] = enus->serial;
+    }
     if(i==enus->nbKnownDevices){
         wpSafeRegister(enus->hub,enus->devYdx,enus->serial,enus->logicalName,enus->productName,enus->productId,enus->hubref,enus->beacon);
     } else{
@@ -1108,6 +1953,26 @@ static int yNetHubEnumEx(HubSt *hub, ENU_CONTEXT *enus, char *errmsg)
 }
 
 
+// Replace the devYdx map loaded from the warm-start cache by the one of the
+// first successful enumeration: entries of devices that are no longer listed
+// are dropped, and renumbered devices are mapped to their new devYdx
+static void yNetHubCheckCachedMap(HubSt *hub, ENU_CONTEXT *enus)
+{
+    int i, devydx;
+
+    if (enus->enumSerials == NULL) {
+        return;
+    }
+    for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
+        devydx = -1;
+        if (enus->enumSerials[i] != INVALID_HASH_IDX) {
+            devydx = wpGetDevYdx(enus->enumSerials[i]);
+        }
+        hub->devYdxMap[i] = (devydx < 0 ? 255 : (u8)devydx);
+    }
+    hub->devYdxFromCache = 0;
+}
+
 // helper for yNetHubEnumEx that will trigger TCP connection (and potentially
 // timeout) only when it is really needed.
 static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
@@ -1115,6 +1980,7 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
     ENU_CONTEXT     enus;
     int             i, res;
     yStrRef         knownDevices[128];
+    yStrRef         enumSerials[ALLOC_YDX_PER_HUB];
 
     //check if the expiration has expired;
     if(!forceupdate && hub->devListExpires > yapiGetTickCount()) {
@@ -1129,6 +1995,13 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
     if(enus.nbKnownDevices >128){
         return YERRMSG(YAPI_IO_ERROR,"too many device on this Net hub");
     }
+    if (hub->devYdxFromCache) {
+        // the hub may have renumbered its devices since the cache was saved
+        for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
+            enumSerials[i] = INVALID_HASH_IDX;
+        }
+        enus.enumSerials = enumSerials;
+    }
 
 
     if (hub->mandatory) {
@@ -1147,6 +2020,7 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
             if (YISERR(res)) {
                 return res;
             }
+            yNetHubCheckCachedMap(hub, &enus);
         }
     } else {
         // if the hub is optional we will not triger an error but
@@ -1156,6 +2030,8 @@ static int yNetHubEnum(HubSt *hub,int forceupdate,char *errmsg)
             res = yNetHubEnumEx(hub, &enus, errmsg);
             if (YISERR(res)) {
                 dbglog("error with hub %s : %s",hub->name,errmsg);
+            } else {
+                yNetHubCheckCachedMap(hub, &enus);
             }
         }
     }
@@ -1245,6 +2121,131 @@ static void yapiFreeHub(HubSt *hub)
 }
 
 
+/*****************************************************************************
+  Warm-start cache of the device and function lists
+ ****************************************************************************/
+
+#define WARMCACHE_MAX_SIZE  (16*1024*1024)
+
+static char ywarmcachefile[WARMCACHE_NAMELEN] = "";
+
+static void yWarmCacheLoad(void)
+{
+    FILE    *f;
+    long    size;
+    u8      *buffer;
+    int     res;
+
+    if (ywarmcachefile[0] == 0) {
+        return;
+    }
+    if (YFOPEN(&f, ywarmcachefile, "rb") != 0) {
+        return;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0 || size > WARMCACHE_MAX_SIZE || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return;
+    }
+    buffer = (u8*) yMalloc(size);
+    if (fread(buffer, 1, size, f) != (size_t)size) {
+        fclose(f);
+        yFree(buffer);
+        return;
+    }
+    fclose(f);
+    res = yHashLoadCache(buffer, (u32)size);
+    if (res < 0) {
+        dbglog("Ignoring invalid warm-start cache %s\n", ywarmcachefile);
+        yFree(buffer);
+        return;
+    }
+    // keep the cache until all restored devices are reconciled, hub maps are applied on hub registration
+    yContext->warmCache = buffer;
+    yContext->warmCacheSize = (u32)size;
+}
+
+static void yWarmCacheSave(void)
+{
+    char    tmpfile[WARMCACHE_NAMELEN + 4];
+    yUrlRef hubUrls[NBMAX_NET_HUB];
+    u8      *hubMaps[NBMAX_NET_HUB];
+    u8      *buffer;
+    u32     size;
+    int     i, nbHubs = 0;
+    FILE    *f;
+    size_t  written;
+
+    if (ywarmcachefile[0] == 0) {
+        return;
+    }
+    for (i = 0; i < NBMAX_NET_HUB; i++) {
+        if (yContext->nethub[i]) {
+            hubUrls[nbHubs] = yContext->nethub[i]->url;
+            hubMaps[nbHubs] = yContext->nethub[i]->devYdxMap;
+            nbHubs++;
+        }
+    }
+    if (YISERR(yHashSaveCache(hubUrls, hubMaps, nbHubs, &buffer, &size))) {
+        return;
+    }
+    // write to a temporary file first so that a crash never leaves a truncated cache
+    YSPRINTF(tmpfile, WARMCACHE_NAMELEN + 4, "%s.tmp", ywarmcachefile);
+    if (YFOPEN(&f, tmpfile, "wb") != 0) {
+        dbglog("Unable to write warm-start cache %s\n", tmpfile);
+        yFree(buffer);
+        return;
+    }
+    written = fwrite(buffer, 1, size, f);
+    fclose(f);
+    yFree(buffer);
+    if (written != size) {
+        remove(tmpfile);
+        return;
+    }
+    remove(ywarmcachefile);
+    if (rename(tmpfile, ywarmcachefile) != 0) {
+        remove(tmpfile);
+    }
+}
+
+// Drop devices restored from the warm-start cache that the last enumeration
+// did not confirm: USB devices that are not plugged and devices of hubs that
+// are not registered anymore. Devices of registered hubs are reconciled by
+// the hub enumeration itself.
+static void yWarmCacheSweep(void)
+{
+    yStrRef serials[NB_MAX_DEVICES];
+    yUrlRef urls[NB_MAX_DEVICES];
+    int     i, j, nbCached;
+
+    if (yContext->warmCache == NULL) {
+        return;
+    }
+    nbCached = wpGetCachedDevices(serials, urls, NB_MAX_DEVICES);
+    if (nbCached > NB_MAX_DEVICES) {
+        nbCached = NB_MAX_DEVICES;
+    }
+    for (i = 0; i < nbCached; i++) {
+        if (yHashGetUrlPort(urls[i], NULL, NULL, NULL, NULL, NULL, NULL) != USB_URL) {
+            for (j = 0; j < NBMAX_NET_HUB; j++) {
+                if (yContext->nethub[j] && yHashSameHub(yContext->nethub[j]->url, urls[i])) {
+                    break;
+                }
+            }
+            if (j < NBMAX_NET_HUB) {
+                continue;
+            }
+        }
+        unregisterNetDevice(serials[i]);
+    }
+    if (wpGetCachedDevices(serials, urls, 0) == 0) {
+        yFree(yContext->warmCache);
+        yContext->warmCache = NULL;
+        yContext->warmCacheSize = 0;
+    }
+}
+
+
 
 static void unregisterNetHub(yUrlRef  huburl)
 {
@@ -1322,6 +2323,7 @@ static void initializeAllCS(yContextSt *ctx)
     yInitializeCriticalSection(&ctx->deviceCallbackCS);
     yInitializeCriticalSection(&ctx->functionCallbackCS);
     yInitializeCriticalSection(&ctx->generic_cs);
+    yInitializeCriticalSection(&ctx->funFilter_cs);
 #ifdef DEBUG_YAPI_REQ
     yInitializeCriticalSection(&YREQ_CS);
 #endif
@@ -1338,6 +2340,7 @@ static void deleteAllCS(yContextSt *ctx)
     yDeleteCriticalSection(&ctx->deviceCallbackCS);
     yDeleteCriticalSection(&ctx->functionCallbackCS);
     yDeleteCriticalSection(&ctx->generic_cs);
+    yDeleteCriticalSection(&ctx->funFilter_cs);
 }
 
 
@@ -1423,6 +2426,7 @@ static YRETCODE yapiInitAPI_internal(int detect_type,char *errmsg)
 
     //initialize enumeration CS
     initializeAllCS(ctx);
+    yPoolsInit(ctx);
 
     //initialize device pool
     ctx->devs = NULL;
@@ -1430,6 +2434,7 @@ static YRETCODE yapiInitAPI_internal(int detect_type,char *errmsg)
     if(detect_type & Y_DETECT_USB) {
         int res;
         if(YISERR(res=yUsbInit(ctx,errmsg))){
+            yPoolsFree(ctx);
             deleteAllCS(ctx);
             yFree(ctx);
             return (YRETCODE)res;
@@ -1441,23 +2446,30 @@ static YRETCODE yapiInitAPI_internal(int detect_type,char *errmsg)
     yHashInit();
 
     if (YISERR(yTcpInit(errmsg))){
+        yPoolsFree(ctx);
         deleteAllCS(ctx);
         yFree(ctx);
         return YAPI_IO_ERROR;
     }
 
     yCreateEvent(&ctx->exitSleepEvent);
+    ctx->eventFdRead = -1;
+    ctx->eventFdWrite = -1;
 
     if(detect_type & Y_DETECT_NET) {
         if (YISERR(ySSDPStart(&ctx->SSDP, ssdpEntryUpdate, errmsg))){
             yTcpShutdown();
             yCloseEvent(&yContext->exitSleepEvent);
+            yPoolsFree(ctx);
             deleteAllCS(ctx);
             yFree(ctx);
             return YAPI_IO_ERROR;
         }
     }
+    yCbQueueInit(ctx);
     yContext=ctx;
+    yCbQueueStartThreads(ctx);
+    yWarmCacheLoad();
 #ifndef YAPI_IN_YDEVICE
     yProgInit();
 #endif
@@ -1487,6 +2499,7 @@ static void yapiFreeAPI_internal(void)
     }
 
 
+    yCbQueueStopThreads(yContext);
 #ifndef YAPI_IN_YDEVICE
     yProgFree();
 #endif
@@ -1498,6 +2511,11 @@ static void yapiFreeAPI_internal(void)
     }
 
      ySSDPStop(&yContext->SSDP);
+    yWarmCacheSave();
+    if (yContext->warmCache) {
+        yFree(yContext->warmCache);
+        yContext->warmCache = NULL;
+    }
     //unregister all Network hub
     for(i = 0; i < NBMAX_NET_HUB; i++){
         if (yContext->nethub[i]) {
@@ -1507,6 +2525,10 @@ static void yapiFreeAPI_internal(void)
 
     yHashFree();
     yTcpShutdown();
+    yCbQueueFree(yContext);
+    yFunFilterFree(yContext);
+    yEventFdClose(yContext);
+    yPoolsFree(yContext);
     yCloseEvent(&yContext->exitSleepEvent);
 
     yLeaveCriticalSection(&yContext->updateDev_cs);
@@ -1660,26 +2682,48 @@ static void  yapiRegisterDeviceConfigChangeCallback_internal(yapiDeviceUpdateCal
     }
 }
 
-
-static void  yapiRegisterFunctionUpdateCallback_internal(yapiFunctionUpdateCallback updateCallback)
+
+static void  yapiRegisterFunctionUpdateCallback_internal(yapiFunctionUpdateCallback updateCallback)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    if(!yContext) {
+        yapiInitAPI_internal(0,errmsg);
+    }
+    if(yContext) {
+        yContext->functionCallback = updateCallback;
+    }
+}
+
+static void  yapiRegisterFunctionNumericCallback_internal(yapiFunctionNumericCallback numericCallback)
+{
+    char errmsg[YOCTO_ERRMSG_LEN];
+    if(!yContext) {
+        yapiInitAPI_internal(0,errmsg);
+    }
+    if(yContext) {
+        yContext->functionNumericCallback = numericCallback;
+    }
+}
+
+static void  yapiRegisterTimedReportCallback_internal(yapiTimedReportCallback timedReportCallback)
 {
     char errmsg[YOCTO_ERRMSG_LEN];
     if(!yContext) {
         yapiInitAPI_internal(0,errmsg);
     }
     if(yContext) {
-        yContext->functionCallback = updateCallback;
+        yContext->timedReportCallback = timedReportCallback;
     }
 }
 
-static void  yapiRegisterTimedReportCallback_internal(yapiTimedReportCallback timedReportCallback)
+static void  yapiRegisterTimedReportExCallback_internal(yapiTimedReportExCallback timedReportCallback)
 {
     char errmsg[YOCTO_ERRMSG_LEN];
     if(!yContext) {
         yapiInitAPI_internal(0,errmsg);
     }
     if(yContext) {
-        yContext->timedReportCallback = timedReportCallback;
+        yContext->timedReportExCallback = timedReportCallback;
     }
 }
 
@@ -1708,6 +2752,7 @@ static void wpUpdateTCP(HubSt *hub, const char *serial, const char *name, u8 bea
     yStrRef lnameref;
     yUrlRef devurl;
     int devydx;
+    int fromCache;
 
     serialref = yHashPutStr(serial);
     devydx = wpGetDevYdx(serialref);
@@ -1728,13 +2773,22 @@ static void wpUpdateTCP(HubSt *hub, const char *serial, const char *name, u8 bea
         devurl = hub->url;
     }
     lnameref    = yHashPutStr(name);
+    // devices restored from warm-start cache were never announced to the user
+    fromCache = wpIsFromCache(serialref);
     status = wpRegister(-1, serialref, lnameref, INVALID_HASH_IDX, 0, devurl, beacon);
     if (status == 0) {
         return; // no change
     }
     ypRegister(YSTRREF_MODULE_STRING, serialref, YSTRREF_mODULE_STRING, lnameref, YOCTO_AKA_YFUNCTION, -1, NULL);
     // Forward high-level notification to API user
-    if(yContext->changeCallback){
+    if (status == 2 && fromCache) {
+        // device restored from warm-start cache seen for the first time
+        if (yContext->arrivalCallback) {
+            yEnterCriticalSection(&yContext->deviceCallbackCS);
+            yContext->arrivalCallback(serialref);
+            yLeaveCriticalSection(&yContext->deviceCallbackCS);
+        }
+    } else if(yContext->changeCallback){
         yEnterCriticalSection(&yContext->deviceCallbackCS);
         yContext->changeCallback(serialref);
         yLeaveCriticalSection(&yContext->deviceCallbackCS);
@@ -1773,8 +2827,9 @@ int handleNetNotification(HubSt *hub)
     if(size < NOTIFY_NETPKT_START_LEN) {
         return 0;
     }
-    // make sure we have a full notification
-    end = ySeekFifo(&(hub->not_fifo), (u8*) &netstop, 1, 0, 0, 0);
+    // make sure we have a full notification (resume the search where the
+    // previous call stopped while the notification was still incomplete)
+    end = ySeekFifoResume(&(hub->not_fifo), (u8*) &netstop, 1, 0);
     if(end == 0xffff){
         if (yFifoGetFree(&(hub->not_fifo)) == 0) {
             dbglog("Too many invalid notifications, clearing buffer\n");
@@ -1830,14 +2885,11 @@ int handleNetNotification(HubSt *hub)
                 // Map hub-specific devydx to our devydx
                 devydx = hub->devYdxMap[devydx];
                 if(devydx < MAX_YDX_PER_HUB) {
-                    yEnterCriticalSection(&yContext->generic_cs);
-                    if (yContext->generic_infos[devydx].flags & DEVGEN_LOG_ACTIVATED) {
-                        yContext->generic_infos[devydx].flags |= DEVGEN_LOG_PENDING;
+                    if (yNotifyDeviceLog(devydx)) {
 #ifdef DEBUG_NET_NOTIFICATION
                         dbglog("notify device log for devydx %d\n", devydx);
 #endif
                     }
-                    yLeaveCriticalSection(&yContext->generic_cs);
                 }
                 break;
             case NOTIFY_NETPKT_CONFCHGYDX:
@@ -1882,19 +2934,16 @@ int handleNetNotification(HubSt *hub)
     #endif
                 if(funydx == 15) {
                     u32 t = report[1] + 0x100u * report[2] + 0x10000u * report[3] + 0x1000000u * report[4];
-                    yEnterCriticalSection(&yContext->generic_cs);
-                    yContext->generic_infos[devydx].deviceTime = (double)t + report[5] / 250.0;
-                    yLeaveCriticalSection(&yContext->generic_cs);
+                    // notifications are parsed by the hub thread as soon as they arrive
+                    yUpdateDeviceTime(devydx, (double)t + report[5] / 250.0, yapiGetTickCountUs());
                 } else {
                     Notification_funydx funInfo;
                     YAPI_FUNCTION fundesc;
-                    double deviceTime;
-                    yEnterCriticalSection(&yContext->generic_cs);
-                    deviceTime = yContext->generic_infos[devydx].deviceTime;
-                    yLeaveCriticalSection(&yContext->generic_cs);
+                    double deviceTime, hostTime;
+                    yGetDeviceTime(devydx, &deviceTime, &hostTime);
                     funInfo.raw = funydx;
                     ypRegisterByYdx(devydx, funInfo, NULL, &fundesc);
-                    yFunctionTimedUpdate(fundesc, deviceTime, report, pos);
+                    yFunctionTimedUpdate(fundesc, deviceTime, hostTime, report, pos);
                 }
                 break;
             case NOTIFY_NETPKT_FUNCV2YDX:
@@ -2115,14 +3164,11 @@ int handleNetNotification(HubSt *hub)
                 yStrRef serialref = yHashPutStr(serial);
                 int devydx = wpGetDevYdx(serialref);
                 if (devydx >= 0) {
-                    yEnterCriticalSection(&yContext->generic_cs);
-                    if (yContext->generic_infos[devydx].flags & DEVGEN_LOG_ACTIVATED) {
-                        yContext->generic_infos[devydx].flags |= DEVGEN_LOG_PENDING;
+                    if (yNotifyDeviceLog(devydx)) {
 #ifdef DEBUG_NET_NOTIFICATION
                         dbglog("notify device log for %s (%d)\n", serial,devydx);
 #endif
                     }
-                    yLeaveCriticalSection(&yContext->generic_cs);
                 }
             }
             break;
@@ -2170,15 +3216,11 @@ static void* yhelper_thread(void* ctx)
 
 
 
+    yThreadApplyRole(YAPI_THREAD_HUB);
     yThreadSignalStart(thread);
     while (!yThreadMustEnd(thread)) {
         // Handle async connections as well in this thread
-        for (i = 0; i < ALLOC_YDX_PER_HUB; i++) {
-            int devydx = hub->devYdxMap[i];
-            if (devydx != 0xff){
-                yapiPullDeviceLogEx(devydx);
-            }
-        }
+        yPullPendingDeviceLogs();
         towatch=0;
         if (hub->state == NET_HUB_ESTABLISHED || hub->state == NET_HUB_TRYING) {
             selectlist[towatch] = hub->http.notReq;
@@ -2189,7 +3231,6 @@ static void* yhelper_thread(void* ctx)
         } else if (hub->state == NET_HUB_DISCONNECTED) {
             u64 now;
             if(hub->http.notReq == NULL) {
-                hub->http.notReq = (RequestSt*) yMalloc(sizeof(RequestSt));
                 hub->http.notReq = yReqAlloc(hub);
             }
             now = yapiGetTickCount();
@@ -2289,6 +3330,9 @@ static void* yhelper_thread(void* ctx)
                             }
                             if(hub->state == NET_HUB_ESTABLISHED) {
                                 while(handleNetNotification(hub));
+                                // callbacks may have been queued by the application
+                                // layer, to be run from yapiHandleEvents
+                                ySignalEvents();
                             }
                             hub->http.lastTraffic = yapiGetTickCount();
                         } else {
@@ -2355,6 +3399,9 @@ static YRETCODE  yapiLockFunctionCallBack_internal(char *errmsg)
     if(!yContext)
         return YERR(YAPI_NOT_INITIALIZED);
     yEnterCriticalSection(&yContext->functionCallbackCS);
+    if (yContext->cbNbThreads > 0) {
+        yEnterWriteLock(&yContext->cbThreadsLock);
+    }
     return YAPI_SUCCESS;
 }
 
@@ -2363,11 +3410,272 @@ static YRETCODE  yapiUnlockFunctionCallBack_internal(char *errmsg)
 {
     if(!yContext)
         return YERR(YAPI_NOT_INITIALIZED);
+    if (yContext->cbNbThreads > 0) {
+        yLeaveWriteLock(&yContext->cbThreadsLock);
+    }
     yLeaveCriticalSection(&yContext->functionCallbackCS);
     return YAPI_SUCCESS;
 }
 
 
+static YRETCODE  yapiSetEventQueue_internal(int mode, int size, char *errmsg)
+{
+    u32 nbItems = 2;
+
+    if(yContext)
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Event queue must be configured before yInitAPI");
+    if(mode < YAPI_EVQUEUE_NONE || mode > YAPI_EVQUEUE_LATEST_VALUE || size < 0 || size > 0x100000)
+        return YERR(YAPI_INVALID_ARGUMENT);
+    while((int)nbItems < size) {
+        nbItems <<= 1;
+    }
+    ycbqueuemode = mode;
+    ycbqueuesize = (size > 0 ? nbItems : 0);
+    return YAPI_SUCCESS;
+}
+
+static YRETCODE  yapiSetThreadConfig_internal(int role, u64 cpuMask, int rtPriority, char *errmsg)
+{
+    if (yContext)
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Threads must be configured before yInitAPI");
+    if (role < 0 || role >= YAPI_THREAD_ROLES || rtPriority < 0 || rtPriority > 99)
+        return YERR(YAPI_INVALID_ARGUMENT);
+    ythreadcfg[role].cpumask = cpuMask;
+    ythreadcfg[role].priority = rtPriority;
+    return YAPI_SUCCESS;
+}
+
+static void  yapiSetCallbackThreads_internal(int nbThreads)
+{
+    if (yContext) {
+        dbglog("Callback threads must be configured before yInitAPI\n");
+        return;
+    }
+    if (nbThreads < 0) {
+        nbThreads = 0;
+    } else if (nbThreads > YCBEV_MAX_THREADS) {
+        nbThreads = YCBEV_MAX_THREADS;
+    }
+    ycbthreads = nbThreads;
+}
+
+static YRETCODE  yapiSetFunctionValueFilter_internal(YAPI_FUNCTION fundesc, int minIntervalMs, double deadband, char *errmsg)
+{
+    yFunFilter  *f;
+    int         wasActive, isActive;
+
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    if(fundesc == 0 || minIntervalMs < 0 || deadband < 0)
+        return YERR(YAPI_INVALID_ARGUMENT);
+    isActive = (minIntervalMs > 0 || deadband > 0);
+    yEnterCriticalSection(&yContext->funFilter_cs);
+    if(!yContext->funFilters) {
+        if(!isActive) {
+            yLeaveCriticalSection(&yContext->funFilter_cs);
+            return YAPI_SUCCESS;
+        }
+        yContext->funFilters = (yFunFilter*) yMalloc(YFUNFILTER_SIZE * sizeof(yFunFilter));
+        memset(yContext->funFilters, 0, YFUNFILTER_SIZE * sizeof(yFunFilter));
+    }
+    f = yFunFilterFind(fundesc, isActive);
+    if(!f) {
+        yLeaveCriticalSection(&yContext->funFilter_cs);
+        if(!isActive)
+            return YAPI_SUCCESS;
+        return YERRMSG(YAPI_EXHAUSTED, "Too many function value filters");
+    }
+    wasActive = (f->minInterval > 0 || f->deadband > 0);
+    f->minInterval = (u32)minIntervalMs;
+    f->deadband = deadband;
+    if(isActive && !wasActive) {
+        yAtomicAdd32(&yContext->funFilterCount, 1);
+    } else if(!isActive && wasActive) {
+        yAtomicAdd32(&yContext->funFilterCount, -1);
+    }
+    if(!isActive && !f->pending) {
+        yFunFilterRelease((u32)(f - yContext->funFilters));
+    }
+    yLeaveCriticalSection(&yContext->funFilter_cs);
+    // a value still held back is now due, the slot is released once it is delivered
+    if(!isActive) {
+        yFunFilterWakeup();
+    }
+    return YAPI_SUCCESS;
+}
+
+static int  yapiGetEventFd_internal(char *errmsg)
+{
+#ifdef WINDOWS_API
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    return YERRMSG(YAPI_NOT_SUPPORTED, "Event file descriptor is not supported on Windows");
+#else
+    int fd;
+
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    yEnterCriticalSection(&yContext->generic_cs);
+    if(yContext->eventFdRead < 0) {
+#ifdef LINUX_API
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(fd >= 0) {
+            yContext->eventFdWrite = fd;
+            yContext->eventFdRead = fd;
+        }
+#else
+        int fds[2];
+        if(pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            yContext->eventFdWrite = fds[1];
+            yContext->eventFdRead = fds[0];
+        }
+#endif
+    }
+    fd = yContext->eventFdRead;
+    yLeaveCriticalSection(&yContext->generic_cs);
+    if(fd < 0)
+        return YERRMSG(YAPI_IO_ERROR, "Unable to create event file descriptor");
+    // events may have been received before the descriptor existed
+    ySignalEvents();
+    return fd;
+#endif
+}
+
+static YRETCODE  yapiGetEventQueueStats_internal(u32 *nbQueued, u32 *nbDropped, u32 *nbCoalesced, char *errmsg)
+{
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    if(nbQueued) *nbQueued = yAtomicLoad32(&yContext->cbNbQueued);
+    if(nbDropped) *nbDropped = yAtomicLoad32(&yContext->cbNbDropped);
+    if(nbCoalesced) *nbCoalesced = yAtomicLoad32(&yContext->cbNbCoalesced);
+    return YAPI_SUCCESS;
+}
+
+
+static YRETCODE  yapiGetPoolStats_internal(int pool, u32 *inUse, u32 *peak, u32 *reused, u32 *allocated, char *errmsg)
+{
+    yPool   *pools;
+    int     nbpools, k;
+    u32     cnt[4] = {0, 0, 0, 0};
+
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    switch(pool) {
+    case YAPI_POOL_REQUEST: pools = &yContext->reqPool; nbpools = 1; break;
+    case YAPI_POOL_PACKET:  pools = &yContext->pktPool; nbpools = 1; break;
+    case YAPI_POOL_IOHDL:   pools = &yContext->iohdlPool; nbpools = 1; break;
+    case YAPI_POOL_BUFFER:  pools = yContext->bufPool; nbpools = YBUF_POOL_CLASSES; break;
+    default:
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Unknown pool");
+    }
+    for(k = 0; k < nbpools; k++) {
+        yEnterCriticalSection(&pools[k].cs);
+        cnt[0] += pools[k].inuse;
+        cnt[1] += pools[k].peak;
+        cnt[2] += pools[k].reused;
+        cnt[3] += pools[k].allocated;
+        yLeaveCriticalSection(&pools[k].cs);
+    }
+    if(inUse) *inUse = cnt[0];
+    if(peak) *peak = cnt[1];
+    if(reused) *reused = cnt[2];
+    if(allocated) *allocated = cnt[3];
+    return YAPI_SUCCESS;
+}
+
+
+static YRETCODE  yapiSetMemoryLimit_internal(int subsystem, u32 limit, char *errmsg)
+{
+    if(subsystem < 0 || subsystem >= YAPI_MEM_COUNT)
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Unknown memory subsystem");
+    if(subsystem == YAPI_MEM_HASH && limit != 0)
+        return YERRMSG(YAPI_NOT_SUPPORTED, "Hash tables are allocated statically");
+    yMemSetLimit(subsystem, limit);
+    return YAPI_SUCCESS;
+}
+
+
+static YRETCODE  yapiGetMemoryStats_internal(int subsystem, u32 *used, u32 *peak, u32 *limit, char *errmsg)
+{
+    if(subsystem < 0 || subsystem >= YAPI_MEM_COUNT)
+        return YERRMSG(YAPI_INVALID_ARGUMENT, "Unknown memory subsystem");
+    yMemGetStats(subsystem, used, peak, limit);
+    return YAPI_SUCCESS;
+}
+
+
+#ifdef PROFILE_CRITICAL_SECTION
+// sort call sites by decreasing wait time
+static int yCsProfCompare(const void *a, const void *b)
+{
+    u64 wa = ((const yCsProfStat*)a)->waitns;
+    u64 wb = ((const yCsProfStat*)b)->waitns;
+
+    return (wa < wb ? 1 : (wa > wb ? -1 : 0));
+}
+
+// strip the directory from a __FILE__ path
+static const char* yCsProfFileName(const char *path)
+{
+    const char *p = path + YSTRLEN(path);
+
+    while (p > path && p[-1] != '/' && p[-1] != '\\') p--;
+    return p;
+}
+#endif
+
+static YRETCODE  yapiGetLockProfile_internal(char *buffer, int maxsize, int *neededsize, int reset, char *errmsg)
+{
+#ifdef PROFILE_CRITICAL_SECTION
+    yCsProfStat *stats;
+    char        line[256];
+    int         nbstats, nb, i, len, total, copied;
+
+    if (buffer == NULL && neededsize == NULL)
+        return YERR(YAPI_INVALID_ARGUMENT);
+    nbstats = yCsProfileSnapshot(NULL, 0, 0) + 16;
+    stats = (yCsProfStat*)yMalloc(nbstats * sizeof(yCsProfStat));
+    nb = yCsProfileSnapshot(stats, nbstats, reset);
+    if (nb > nbstats) nb = nbstats;
+    qsort(stats, nb, sizeof(yCsProfStat), yCsProfCompare);
+    total = copied = 0;
+    for (i = -1; i < nb; i++) {
+        if (i < 0) {
+            YSTRCPY(line, sizeof(line), "lock;site;acquisitions;contended;wait_us;max_wait_us;hold_us;max_hold_us\n");
+        } else {
+            YSPRINTF(line, sizeof(line), "%s:%d;%s:%d;%u;%u;%"FMTu64";%u;%"FMTu64";%u\n",
+                yCsProfFileName(stats[i].csfile), stats[i].csline, yCsProfFileName(stats[i].file), stats[i].line,
+                stats[i].acquisitions, stats[i].contended, stats[i].waitns / 1000, stats[i].maxwaitus,
+                stats[i].holdns / 1000, stats[i].maxholdus);
+        }
+        len = YSTRLEN(line);
+        // only whole lines are copied, and none after the first that does not fit
+        if (buffer && copied == total && total + len < maxsize) {
+            memcpy(buffer + total, line, len);
+            copied += len;
+        }
+        total += len;
+    }
+    yFree(stats);
+    if (buffer && maxsize > 0) {
+        buffer[copied] = 0;
+    }
+    if (neededsize) *neededsize = total + 1;
+    return YAPI_SUCCESS;
+#else
+    (void)buffer;
+    (void)maxsize;
+    (void)neededsize;
+    (void)reset;
+    return YERRMSG(YAPI_NOT_SUPPORTED, "Library built without PROFILE_CRITICAL_SECTION");
+#endif
+}
+
+
 static YRETCODE  yapiLockDeviceCallBack_internal(char *errmsg)
 {
     if(!yContext)
@@ -2455,6 +3763,12 @@ static YRETCODE yapiRegisterHubEx(const char* url, int checkacces, char* errmsg)
             dbglog("HUB: register %x->%s \n", hubst->url, hubst->name);
 #endif
             yContext->nethub[i] = hubst;
+            if (yContext->warmCache) {
+                // route notifications of cached devices until the first enumeration checks the map
+                if (yHashLoadCacheHubMap(yContext->warmCache, yContext->warmCacheSize, hubst->url, hubst->devYdxMap) > 0) {
+                    hubst->devYdxFromCache = 1;
+                }
+            }
             if (YISERR(res = yStartWakeUpSocket(&yContext->nethub[i]->wuce, errmsg))) {
                 yLeaveCriticalSection(&yContext->enum_cs);
                 return (YRETCODE)res;
@@ -2742,6 +4056,7 @@ static YRETCODE  yapiUpdateDeviceList_internal(u32 forceupdate, char *errmsg)
             }
         }
     }
+    yWarmCacheSweep();
     yLeaveCriticalSection(&yContext->updateDev_cs);
 
     return err;
@@ -2754,7 +4069,11 @@ static YRETCODE  yapiHandleEvents_internal(char *errmsg)
         return YERR(YAPI_NOT_INITIALIZED);
      // we need only one thread to handle the event at a time
     if(yTryEnterCriticalSection(&yContext->handleEv_cs)){
-        YRETCODE res = (YRETCODE) yUsbIdle();
+        YRETCODE res;
+        yEventFdDrain();
+        res = (YRETCODE) yUsbIdle();
+        yFunFilterFlush();
+        yCbQueueDispatch();
         yLeaveCriticalSection(&yContext->handleEv_cs);
         return res;
     }
@@ -2796,8 +4115,14 @@ static int                 tickUseHiRes = -1;
 static u64                 tickOffset = 0;
 static LARGE_INTEGER       tickFrequency;
 static LARGE_INTEGER       tickStart;
+#else
+static volatile u32        tickInit = 0;
+static u64                 tickOffset = 0;
 #endif
-u64 YAPI_FUNCTION_EXPORT yapiGetTickCount(void)
+// The offset is set on first use so that the counter starts close to the
+// time since January 1st 1970, but it never follows the system clock steps
+// (NTP adjustments, manual changes) afterwards.
+u64 YAPI_FUNCTION_EXPORT yapiGetTickCountUs(void)
 {
     u64 res;
 
@@ -2807,33 +4132,56 @@ u64 YAPI_FUNCTION_EXPORT yapiGetTickCount(void)
     if(tickUseHiRes < 0){
         if (QueryPerformanceFrequency(&tickFrequency)){
             tickUseHiRes = 1;
-            tickOffset = (u64)time(NULL) * 1000u;
+            tickOffset = (u64)time(NULL) * 1000000u;
             QueryPerformanceCounter(&tickStart);
         } else {
             tickUseHiRes = 0;
-            tickOffset = (u64)time(NULL) * 1000u - GetTickCount();
+            tickOffset = ((u64)time(NULL) * 1000u - GetTickCount()) * 1000u;
         }
         // make sure the offset is always > 0
         if((s64)tickOffset <= 0) tickOffset = 1;
     }
     if(tickUseHiRes>0) {
+        u64 ticks;
         QueryPerformanceCounter(&performanceCounter);
-        performanceCounter.QuadPart -= tickStart.QuadPart;
-        // we add +1 because it is not nice to start with zero
-        res = performanceCounter.QuadPart * 1000 / tickFrequency.QuadPart + tickOffset;
+        ticks = (u64)(performanceCounter.QuadPart - tickStart.QuadPart);
+        // split the conversion to avoid overflowing after a few days
+        res = (ticks / tickFrequency.QuadPart) * 1000000u;
+        res += (ticks % tickFrequency.QuadPart) * 1000000u / tickFrequency.QuadPart;
+        res += tickOffset;
     } else {
-        res = GetTickCount() + tickOffset;
+        res = (u64)GetTickCount() * 1000u + tickOffset;
+    }
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    res = (u64)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+    if(yAtomicLoad32(&tickInit) != 2) {
+        if(yAtomicCAS32(&tickInit, 0, 1)) {
+            struct timeval tim;
+            gettimeofday(&tim, NULL);
+            tickOffset = (u64)tim.tv_sec * 1000000u + tim.tv_usec - res;
+            yAtomicStore32(&tickInit, 2);
+        } else {
+            while(yAtomicLoad32(&tickInit) != 2);
+        }
     }
+    res += tickOffset;
 #else
     //get the current number of microseconds since January 1st 1970
     struct timeval tim;
     gettimeofday(&tim, NULL);
-    res = (u64)tim.tv_sec * 1000 + (tim.tv_usec / 1000);
+    res = (u64)tim.tv_sec * 1000000u + tim.tv_usec;
 #endif
 
     return res;
 }
 
+u64 YAPI_FUNCTION_EXPORT yapiGetTickCount(void)
+{
+    return yapiGetTickCountUs() / 1000u;
+}
+
 u32  yapiGetCNonce(u32 nc)
 {
     HASH_SUM ctx;
@@ -2903,6 +4251,17 @@ static void  yapiSetTraceFile_internal(const char *file)
 }
 
 
+static void  yapiSetWarmCacheFile_internal(const char *file)
+{
+    if(file!=NULL){
+        memset(ywarmcachefile,0,WARMCACHE_NAMELEN);
+        YSTRNCPY(ywarmcachefile,WARMCACHE_NAMELEN-1,file,WARMCACHE_NAMELEN-1);
+    }else{
+        ywarmcachefile[0]=0;
+    }
+}
+
+
 static YAPI_DEVICE  yapiGetDevice_internal(const char *device_str, char *errmsg)
 {
     char    hostname[HASH_BUF_SIZE], c;
@@ -2968,6 +4327,33 @@ static int  yapiGetAllDevices_internal(YAPI_DEVICE *buffer, int maxsize, int *ne
 }
 
 
+static YRETCODE  yapiDeviceTimeToHostTime_internal(YAPI_DEVICE devdesc, double deviceTime, double *hostTime, double *drift, char *errmsg)
+{
+    yClockModel *clk;
+    int         devydx;
+    YRETCODE    res = YAPI_SUCCESS;
+
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    if(devdesc < 0 || hostTime == NULL)
+        return YERR(YAPI_INVALID_ARGUMENT);
+    devydx = wpGetDevYdx((yStrRef)(devdesc & 0xffff));
+    if(devydx < 0)
+        return YERR(YAPI_DEVICE_NOT_FOUND);
+    clk = &yContext->generic_infos[devydx].clock;
+    yEnterCriticalSection(&yContext->generic_cs);
+    if(clk->nbSamples == 0) {
+        res = YAPI_RTC_NOT_READY;
+    } else {
+        *hostTime = deviceTime + clk->offset + clk->drift * (deviceTime - clk->devRef);
+        if(drift) *drift = clk->drift;
+    }
+    yLeaveCriticalSection(&yContext->generic_cs);
+    if(res != YAPI_SUCCESS)
+        return YERRMSG(res, "No timed report received from this device");
+    return YAPI_SUCCESS;
+}
+
 static YRETCODE  yapiGetDeviceInfo_internal(YAPI_DEVICE devdesc, yDeviceSt *infos, char *errmsg)
 {
     YUSBDEV devhdl;
@@ -3129,6 +4515,16 @@ static YRETCODE  yapiGetFunctionInfoEx_internal(YAPI_FUNCTION fundesc, YAPI_DEVI
     return YAPI_SUCCESS;
 }
 
+static int  yapiGetFunctionsSnapshot_internal(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize, char *errmsg)
+{
+    if(!yContext)
+        return YERR(YAPI_NOT_INITIALIZED);
+    if(buffer==NULL && neededsize==NULL){
+        return YERR(YAPI_INVALID_ARGUMENT);
+    }
+    return ypGetFunctionsSnapshot(class_str, buffer, maxsize, neededsize);
+}
+
 
 static int yapiRequestOpenUSB(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE dev, const char *request, int reqlen, u64 unused_timeout, yapiRequestAsyncCallback callback, void *context, char *errmsg)
 {
@@ -3138,6 +4534,11 @@ static int yapiRequestOpenUSB(YIOHDL_internal *iohdl, HubSt *hub, YAPI_DEVICE de
     u64         timeout;
     int         count = 0;
 
+    // the USB memory limit is enforced when a request starts: the packets of
+    // the requests already running must all be queued, or the stream breaks
+    if (yMemOverLimit(YAPI_MEM_USB, 0)) {
+        return YERRMSG(YAPI_EXHAUSTED, "USB memory limit reached");
+    }
     yHashGetStr(dev & 0xffff, buffer, YOCTO_SERIAL_LEN);
     timeout = yapiGetTickCount() + YAPI_BLOCKING_USBOPEN_REQUEST_TIMEOUT;
     do {
@@ -3336,6 +4737,9 @@ YRETCODE yapiRequestOpen(YIOHDL_internal *iohdl, int tcpchan, const char *device
     }
 }
 
+// size of the reply buffer of USB devices, which grows for large replies
+#define YUSB_REPLYBUF_SIZE 2048
+
 static int yapiRequestWaitEndUSB(YIOHDL_internal *iohdl, char **reply, int *replysize, char *errmsg)
 {
     u64      timeout;
@@ -3350,8 +4754,9 @@ static int yapiRequestWaitEndUSB(YIOHDL_internal *iohdl, char **reply, int *repl
         return YERR(YAPI_DEVICE_NOT_FOUND);
     }
     if (p->replybuf == NULL) {
-        p->replybufsize = 2048;
+        p->replybufsize = YUSB_REPLYBUF_SIZE;
         p->replybuf = (char*)yMalloc(p->replybufsize);
+        yMemCharge(YAPI_MEM_USB, p->replybufsize);
     }
     while ((res = (YRETCODE)yUsbEOF(iohdl, errmsg)) == 0) {
         if (yapiGetTickCount() > timeout) {
@@ -3360,6 +4765,11 @@ static int yapiRequestWaitEndUSB(YIOHDL_internal *iohdl, char **reply, int *repl
         }
         if (buffpos + 256 > p->replybufsize) {
             char *newbuff;
+            if (yMemOverLimit(YAPI_MEM_USB, p->replybufsize)) {
+                yUsbClose(iohdl, NULL);
+                return YERRMSG(YAPI_EXHAUSTED, "USB reply exceeds the memory limit");
+            }
+            yMemCharge(YAPI_MEM_USB, p->replybufsize);
             p->replybufsize <<= 1;
             newbuff = (char*)yMalloc(p->replybufsize);
             memcpy(newbuff, p->replybuf, buffpos);
@@ -3380,6 +4790,20 @@ static int yapiRequestWaitEndUSB(YIOHDL_internal *iohdl, char **reply, int *repl
     return res;
 }
 
+// Give back the memory of a large USB reply once the request is done, while
+// the device is still reserved for this request
+static void yapiShrinkReplyUSB(YIOHDL_internal *iohdl)
+{
+    yPrivDeviceSt *p = findDevFromIOHdl(iohdl);
+
+    if (p != NULL && p->replybuf != NULL && p->replybufsize > YUSB_REPLYBUF_SIZE) {
+        yFree(p->replybuf);
+        yMemUncharge(YAPI_MEM_USB, p->replybufsize - YUSB_REPLYBUF_SIZE);
+        p->replybufsize = YUSB_REPLYBUF_SIZE;
+        p->replybuf = (char*)yMalloc(p->replybufsize);
+    }
+}
+
 
 static int yapiRequestWaitEndHTTP(YIOHDL_internal *iohdl, char **reply, int *replysize, char *errmsg)
 {
@@ -3447,10 +4871,10 @@ YRETCODE  yapiHTTPRequestSyncStartEx_internal(YIOHDL *iohdl, int tcpchan, const
 
 
     *reply = NULL;
-    internalio = yMalloc(sizeof(YIOHDL_internal));
+    internalio = yPoolAlloc(&yContext->iohdlPool);
     memset((u8 *)iohdl, 0, YIOHDL_SIZE);
     if (YISERR(res = yapiRequestOpen(internalio, tcpchan, device, request, requestsize, NULL, NULL, progress_cb, progress_ctx, errmsg))) {
-        yFree(internalio);
+        yPoolRelease(&yContext->iohdlPool, internalio);
     } else {
 
         if (internalio->type == YIO_USB) {
@@ -3460,7 +4884,7 @@ YRETCODE  yapiHTTPRequestSyncStartEx_internal(YIOHDL *iohdl, int tcpchan, const
         } else if (internalio->type == YIO_WS) {
             res = yapiRequestWaitEndWS(internalio, reply, replysize, errmsg);
         } else {
-            yFree(internalio);
+            yPoolRelease(&yContext->iohdlPool, internalio);
             return YERR(YAPI_INVALID_ARGUMENT);
         }
 
@@ -3514,6 +4938,7 @@ YRETCODE  yapiHTTPRequestSyncDone_internal(YIOHDL *iohdl, char *errmsg)
 
 
     if(arg->type == YIO_USB) {
+        yapiShrinkReplyUSB(arg);
         yUsbClose(arg, errmsg);
     } else if(arg->type == YIO_TCP) {
         RequestSt *tcpreq = yContext->tcpreq[arg->tcpreqidx];
@@ -3522,7 +4947,7 @@ YRETCODE  yapiHTTPRequestSyncDone_internal(YIOHDL *iohdl, char *errmsg)
         yReqClose(arg->ws);
         yReqFree(arg->ws);
     }
-    yFree(arg);
+    yPoolRelease(&yContext->iohdlPool, arg);
     memset((u8 *)iohdl, 0, YIOHDL_SIZE);
     return YAPI_SUCCESS;
 }
@@ -3875,6 +5300,7 @@ static const char*  yapiJsonValueParseStruct(yJsonStateMachine *j, const char *p
                     }
                 } else{
                     const char *start_of_json;
+                    yJsonSlice slice;
 #ifdef DEBUG_JSON_PARSE
                     dbglog("found %s %s(%d):%s\n", j->token, yJsonStateStr[j->st], j->st, j->token);
 #endif
@@ -3882,8 +5308,10 @@ static const char*  yapiJsonValueParseStruct(yJsonStateMachine *j, const char *p
                     start_of_json = j->state_start;
                     switch (j->st){
                     case YJSON_PARSE_STRING:
-                        while (j->next == YJSON_PARSE_STRINGCONT) {
-                            yJsonParse(j);
+                        if (!yJsonStringSlice(j, &slice)) {
+                            while (j->next == YJSON_PARSE_STRINGCONT) {
+                                yJsonParse(j);
+                            }
                         }
                     case YJSON_PARSE_NUM:
                         *result = (u32)(j->state_end - start_of_json);
@@ -3976,6 +5404,7 @@ static const char*  yapiJsonValueParseArray(yJsonStateMachine *j, const char *pa
 static int  yapiJsonDecodeString_internal(const char *json_string, char *output)
 {
     yJsonStateMachine j;
+    yJsonSlice slice;
     char *p = output;
     int maxsize = YSTRLEN(json_string);
 
@@ -3983,6 +5412,16 @@ static int  yapiJsonDecodeString_internal(const char *json_string, char *output)
     j.end = j.src + maxsize;
     j.st = YJSON_START;
     yJsonParse(&j);
+    if (j.st == YJSON_PARSE_STRING && yJsonStringSlice(&j, &slice)) {
+        if (slice.escaped) {
+            p += yJsonUnescape(slice.ptr, slice.len, p, maxsize);
+        } else {
+            yMemcpy(p, slice.ptr, slice.len);
+            p += slice.len;
+        }
+        *p = 0;
+        return (u32)(p - output);
+    }
     do {
         int len = YSTRLEN(j.token);
         yMemcpy(p, j.token, len);
@@ -4042,6 +5481,8 @@ static fullAttrInfo* parseSettings(const char *settings, int *count)
     fullAttrInfo     *attrBuff=NULL;
     char              func[32];
     char              attr[32];
+    yJsonSlice        slice;
+    int               len;
 
     // Parse HTTP header
     j.src = settings;
@@ -4084,9 +5525,19 @@ static fullAttrInfo* parseSettings(const char *settings, int *count)
                     }
                     YSTRCPY(attrBuff[nbAttr].func, 32, func);
                     YSTRCPY(attrBuff[nbAttr].attr, 32, attr);
-                    YSPRINTF(attrBuff[nbAttr].value, 256, "%s", j.token);
-                    while (j.next == YJSON_PARSE_STRINGCONT && yJsonParse(&j) == YJSON_PARSE_AVAIL) {
-                        YSTRCAT(attrBuff[nbAttr].value, 256, j.token);
+                    if (j.st == YJSON_PARSE_STRING && yJsonStringSlice(&j, &slice)) {
+                        if (slice.escaped) {
+                            len = yJsonUnescape(slice.ptr, slice.len, attrBuff[nbAttr].value, 255);
+                        } else {
+                            len = (slice.len < 255 ? slice.len : 255);
+                            memcpy(attrBuff[nbAttr].value, slice.ptr, len);
+                        }
+                        attrBuff[nbAttr].value[len] = 0;
+                    } else {
+                        YSPRINTF(attrBuff[nbAttr].value, 256, "%s", j.token);
+                        while (j.next == YJSON_PARSE_STRINGCONT && yJsonParse(&j) == YJSON_PARSE_AVAIL) {
+                            YSTRCAT(attrBuff[nbAttr].value, 256, j.token);
+                        }
                     }
                     nbAttr++;
                 } else {
@@ -4270,6 +5721,21 @@ typedef enum
     trcFreeMem,
     trcGetSubDevcies,
     trcRegisterDeviceConfigChangeCallback,
+    trcSetWarmCacheFile,
+    trcGetFunctionsSnapshot,
+    trcRegisterFunctionNumericCallback,
+    trcSetEventQueue,
+    trcGetEventQueueStats,
+    trcSetCallbackThreads,
+    trcSetFunctionValueFilter,
+    trcRegisterTimedReportExCallback,
+    trcDeviceTimeToHostTime,
+    trcGetEventFd,
+    trcGetPoolStats,
+    trcSetMemoryLimit,
+    trcGetMemoryStats,
+    trcSetThreadConfig,
+    trcGetLockProfile,
 } TRC_FUN;
 
 static const char * trc_funname[] =
@@ -4330,6 +5796,21 @@ static const char * trc_funname[] =
     "freemem",
     "getsubdev",
     "RegDeviceConfChg",
+    "SetWarmCache",
+    "GetFunctionsSnapshot",
+    "RegNumericCallback",
+    "SetEventQueue",
+    "GetEventQueueStats",
+    "SetCallbackThreads",
+    "SetFunValueFilter",
+    "RegTimedExCallback",
+    "DevTimeToHostTime",
+    "GetEventFd",
+    "GetPoolStats",
+    "SetMemoryLimit",
+    "GetMemoryStats",
+    "SetThreadConfig",
+    "GetLockProfile",
 };
 
 static const char *dlltracefile = YDLL_TRACE_FILE;
@@ -4471,6 +5952,13 @@ void YAPI_FUNCTION_EXPORT yapiRegisterFunctionUpdateCallback(yapiFunctionUpdateC
     YDLL_CALL_LEAVEVOID();
 }
 
+void YAPI_FUNCTION_EXPORT yapiRegisterFunctionNumericCallback(yapiFunctionNumericCallback numericCallback)
+{
+    YDLL_CALL_ENTER(trcRegisterFunctionNumericCallback);
+    yapiRegisterFunctionNumericCallback_internal(numericCallback);
+    YDLL_CALL_LEAVEVOID();
+}
+
 void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportCallback(yapiTimedReportCallback timedReportCallback)
 {
     YDLL_CALL_ENTER(trcRegisterTimedReportCallback);
@@ -4478,6 +5966,22 @@ void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportCallback(yapiTimedReportCallbac
     YDLL_CALL_LEAVEVOID();
 }
 
+void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportExCallback(yapiTimedReportExCallback timedReportCallback)
+{
+    YDLL_CALL_ENTER(trcRegisterTimedReportExCallback);
+    yapiRegisterTimedReportExCallback_internal(timedReportCallback);
+    YDLL_CALL_LEAVEVOID();
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiDeviceTimeToHostTime(YAPI_DEVICE devdesc, double deviceTime, double *hostTime, double *drift, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcDeviceTimeToHostTime);
+    res = yapiDeviceTimeToHostTime_internal(devdesc, deviceTime, hostTime, drift, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
 YRETCODE YAPI_FUNCTION_EXPORT yapiLockFunctionCallBack(char *errmsg)
 {
     YRETCODE res;
@@ -4496,6 +6000,94 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiUnlockFunctionCallBack(char *errmsg)
     return res;
 }
 
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetEventQueue(int mode, int size, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcSetEventQueue);
+    res = yapiSetEventQueue_internal(mode, size, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+void YAPI_FUNCTION_EXPORT yapiSetCallbackThreads(int nbThreads)
+{
+    YDLL_CALL_ENTER(trcSetCallbackThreads);
+    yapiSetCallbackThreads_internal(nbThreads);
+    YDLL_CALL_LEAVEVOID();
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetFunctionValueFilter(YAPI_FUNCTION fundesc, int minIntervalMs, double deadband, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcSetFunctionValueFilter);
+    res = yapiSetFunctionValueFilter_internal(fundesc, minIntervalMs, deadband, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+int YAPI_FUNCTION_EXPORT yapiGetEventFd(char *errmsg)
+{
+    int res;
+    YDLL_CALL_ENTER(trcGetEventFd);
+    res = yapiGetEventFd_internal(errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetEventQueueStats(u32 *nbQueued, u32 *nbDropped, u32 *nbCoalesced, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcGetEventQueueStats);
+    res = yapiGetEventQueueStats_internal(nbQueued, nbDropped, nbCoalesced, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetPoolStats(int pool, u32 *inUse, u32 *peak, u32 *reused, u32 *allocated, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcGetPoolStats);
+    res = yapiGetPoolStats_internal(pool, inUse, peak, reused, allocated, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetMemoryLimit(int subsystem, u32 limit, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcSetMemoryLimit);
+    res = yapiSetMemoryLimit_internal(subsystem, limit, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetMemoryStats(int subsystem, u32 *used, u32 *peak, u32 *limit, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcGetMemoryStats);
+    res = yapiGetMemoryStats_internal(subsystem, used, peak, limit, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetThreadConfig(int role, u64 cpuMask, int rtPriority, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcSetThreadConfig);
+    res = yapiSetThreadConfig_internal(role, cpuMask, rtPriority, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetLockProfile(char *buffer, int maxsize, int *neededsize, int reset, char *errmsg)
+{
+    YRETCODE res;
+    YDLL_CALL_ENTER(trcGetLockProfile);
+    res = yapiGetLockProfile_internal(buffer, maxsize, neededsize, reset, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
 YRETCODE YAPI_FUNCTION_EXPORT yapiLockDeviceCallBack(char *errmsg)
 {
     YRETCODE res;
@@ -4599,6 +6191,13 @@ void YAPI_FUNCTION_EXPORT yapiSetTraceFile(const char *file)
     YDLL_CALL_LEAVEVOID();
 }
 
+void YAPI_FUNCTION_EXPORT yapiSetWarmCacheFile(const char *file)
+{
+    YDLL_CALL_ENTER(trcSetWarmCacheFile);
+    yapiSetWarmCacheFile_internal(file);
+    YDLL_CALL_LEAVEVOID();
+}
+
 YAPI_DEVICE YAPI_FUNCTION_EXPORT yapiGetDevice(const char *device_str, char *errmsg)
 {
     YAPI_DEVICE res;
@@ -4692,6 +6291,15 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiGetFunctionInfoEx(YAPI_FUNCTION fundesc, YAPI_
     return res;
 }
 
+int YAPI_FUNCTION_EXPORT yapiGetFunctionsSnapshot(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize, char *errmsg)
+{
+    int res;
+    YDLL_CALL_ENTER(trcGetFunctionsSnapshot);
+    res = yapiGetFunctionsSnapshot_internal(class_str, buffer, maxsize, neededsize, errmsg);
+    YDLL_CALL_LEAVE(res);
+    return res;
+}
+
 
 YRETCODE YAPI_FUNCTION_EXPORT yapiHTTPRequestSyncStartEx(YIOHDL *iohdl, const char *device, const char *request, int requestsize, char **reply, int *replysize, char *errmsg)
 {
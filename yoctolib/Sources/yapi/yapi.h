@@ -74,14 +74,51 @@ typedef void YAPI_FUNCTION_EXPORT(*yapiDeviceUpdateCallback)(YAPI_DEVICE devdesc
 //       if not null : notify a new value, (a pointer to a  YOCTO_PUBVAL_LEN bytes null terminated string)
 typedef void YAPI_FUNCTION_EXPORT(*yapiFunctionUpdateCallback)(YAPI_FUNCTION fundescr,const char *value);
 
+// prototype of numeric functions value callback
+// valueType : encoding of the value as sent by the device (PUBVAL_C_LONG, PUBVAL_C_FLOAT or PUBVAL_YOCTO_FLOAT_E3)
+// value     : the decoded value (exact for PUBVAL_C_LONG)
+// timestamp : arrival time of the notification, in yapiGetTickCount() units
+typedef void YAPI_FUNCTION_EXPORT(*yapiFunctionNumericCallback)(YAPI_FUNCTION fundescr, int valueType, double value, u64 timestamp);
+
 // prototype of timed report callback
 typedef void YAPI_FUNCTION_EXPORT(*yapiTimedReportCallback)(YAPI_FUNCTION fundesc, double timestamp, const u8 *bytes, u32 len);
 
+// prototype of timed report callback with host-aligned timestamp
+// hostTime : deviceTime converted to the host clock, in seconds (yapiGetTickCountUs() / 1e6),
+//            or 0 as long as the device has not sent its time (no clock model yet)
+typedef void YAPI_FUNCTION_EXPORT(*yapiTimedReportExCallback)(YAPI_FUNCTION fundesc, double deviceTime, double hostTime, const u8 *bytes, u32 len);
+
 // prototype of the ssdp hub discovery callback
 typedef void YAPI_FUNCTION_EXPORT(*yapiHubDiscoveryCallback)(const char *serial, const char *url);
 
 typedef void YAPI_FUNCTION_EXPORT(*yapiDeviceLogCallback)(YAPI_FUNCTION fundescr,const char *line);
 
+// function callback event queue modes (see yapiSetEventQueue)
+#define YAPI_EVQUEUE_NONE           0   // callbacks are invoked by the I/O threads (default)
+#define YAPI_EVQUEUE_DROP_OLDEST    1   // on overflow, the oldest events are dropped
+#define YAPI_EVQUEUE_LATEST_VALUE   2   // on overflow, only the latest value of each function is kept
+
+// memory pools (see yapiGetPoolStats)
+#define YAPI_POOL_REQUEST           0   // network request descriptors
+#define YAPI_POOL_PACKET            1   // USB packet queue items
+#define YAPI_POOL_IOHDL             2   // handles of synchronous HTTP requests
+#define YAPI_POOL_BUFFER            3   // request and reply buffers (all size classes)
+
+// memory accounting subsystems (see yapiSetMemoryLimit)
+#define YAPI_MEM_USB                0   // USB packet queues and USB reply buffers
+#define YAPI_MEM_NET                1   // network requests and their buffers
+#define YAPI_MEM_HASH               2   // hash table, white pages, yellow pages and their indexes
+#define YAPI_MEM_FIRMWARE           3   // firmware images loaded for an update
+#define YAPI_MEM_COUNT              4
+
+// roles of the threads started by the library (see yapiSetThreadConfig)
+#define YAPI_THREAD_USB             0   // USB event and I/O threads
+#define YAPI_THREAD_HUB             1   // network hub threads (HTTP notifications and WebSocket)
+#define YAPI_THREAD_CALLBACK        2   // callback threads (see yapiSetCallbackThreads)
+#define YAPI_THREAD_DISCOVERY       3   // SSDP hub discovery thread
+#define YAPI_THREAD_FIRMWARE        4   // firmware update thread
+#define YAPI_THREAD_ROLES           5
+
 
 /*****************************************************************************
  API FUNCTION DECLARATION
@@ -283,6 +320,27 @@ void YAPI_FUNCTION_EXPORT yapiRegisterDeviceConfigChangeCallback(yapiDeviceUpdat
  ***************************************************************************/
 void YAPI_FUNCTION_EXPORT yapiRegisterFunctionUpdateCallback(yapiFunctionUpdateCallback updateCallback);
 
+/*****************************************************************************
+  Function:
+    void yapiRegisterFunctionNumericCallback(yapiFunctionNumericCallback numericCallback);
+
+  Description:
+    Register a callback function for numeric function values. Typed value
+    notifications carrying a number are decoded straight from the binary
+    payload and passed to this callback. The function update callback still
+    receives every notification, formatted as a string; values are only
+    formatted when a function update callback is registered.
+    To unregister your callback you can call this function with a NULL pointer.
+
+  Parameters:
+    numericCallback : a function to register or NULL to unregister the callback
+
+  Returns:
+    None
+
+ ***************************************************************************/
+void YAPI_FUNCTION_EXPORT yapiRegisterFunctionNumericCallback(yapiFunctionNumericCallback numericCallback);
+
 /*****************************************************************************
   Function:
       void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportCallback(yapiTimedReportCallback timedReportCallback);
@@ -302,6 +360,53 @@ void YAPI_FUNCTION_EXPORT yapiRegisterFunctionUpdateCallback(yapiFunctionUpdateC
  ***************************************************************************/
 void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportCallback(yapiTimedReportCallback timedReportCallback);
 
+
+/*****************************************************************************
+  Function:
+      void yapiRegisterTimedReportExCallback(yapiTimedReportExCallback timedReportCallback);
+
+  Description:
+    Same as yapiRegisterTimedReportCallback, but the callback also gets the
+    time of the report converted to the host clock. The conversion uses a
+    model of each device clock (offset and drift), fitted continuously from
+    the arrival time of the reports, so that the data of several devices can
+    be merged on a single timeline.
+
+  Parameters:
+    timedReportCallback : a function to register or NULL to unregister the callback
+
+  Returns:
+    None
+
+ ***************************************************************************/
+void YAPI_FUNCTION_EXPORT yapiRegisterTimedReportExCallback(yapiTimedReportExCallback timedReportCallback);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiDeviceTimeToHostTime(YAPI_DEVICE devdesc, double deviceTime, double *hostTime, double *drift, char *errmsg)
+
+  Description:
+    Convert a device time (as given to the timed report callbacks) to the
+    host clock, using the clock model of the device.
+
+  Parameters:
+    devdesc    : the device descriptor
+    deviceTime : the device time to convert, in seconds
+    hostTime   : a pointer to the host time, in seconds (yapiGetTickCountUs() / 1e6)
+    drift      : a pointer to the estimated relative drift of the device clock, or NULL
+    errmsg     : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    The model is only available once the device has sent timed reports,
+    otherwise YAPI_RTC_NOT_READY is returned.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiDeviceTimeToHostTime(YAPI_DEVICE devdesc, double deviceTime, double *hostTime, double *drift, char *errmsg);
+
 YRETCODE YAPI_FUNCTION_EXPORT yapiLockFunctionCallBack( char *errmsg);
 
 
@@ -313,6 +418,291 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiLockDeviceCallBack( char *errmsg);
 YRETCODE YAPI_FUNCTION_EXPORT yapiUnlockDeviceCallBack(char *errmsg);
 
 
+/*****************************************************************************
+  Function:
+    YRETCODE yapiSetEventQueue(int mode, int size, char *errmsg)
+
+  Description:
+    Decouple the function value, numeric value and timed report callbacks
+    from the I/O threads. When enabled, the USB and network threads only
+    push compact events into a bounded lock-free queue, and the callbacks
+    are invoked when the application calls yapiHandleEvents (or yapiSleep).
+    A slow callback can then no longer delay the processing of incoming
+    notifications.
+
+  Parameters:
+    mode   : YAPI_EVQUEUE_NONE, YAPI_EVQUEUE_DROP_OLDEST or YAPI_EVQUEUE_LATEST_VALUE
+    size   : the number of events in the queue (rounded up to a power of two),
+             or 0 for the default size
+    errmsg : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    This function must be called before yInitAPI. With YAPI_EVQUEUE_LATEST_VALUE,
+    timed reports and logical name changes are dropped on overflow.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetEventQueue(int mode, int size, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    void yapiSetCallbackThreads(int nbThreads)
+
+  Description:
+    Dispatch the function value, numeric value and timed report callbacks
+    from a pool of dedicated threads instead of yapiHandleEvents. Events are
+    distributed by function descriptor: the events of a given function are
+    always handled by the same thread, in order, while different functions
+    are handled in parallel. The callbacks must therefore be thread-safe.
+
+  Parameters:
+    nbThreads : the number of callback threads (up to 16), or 0 to dispatch
+                the callbacks from yapiHandleEvents
+
+  Returns:
+    None
+
+  Remarks:
+    This function must be called before yInitAPI. Each thread gets its own
+    event queue, as configured by yapiSetEventQueue (by default, 256 events
+    dropping the oldest ones on overflow). yapiLockFunctionCallBack blocks
+    all callback threads, and must not be called from within a callback.
+ ***************************************************************************/
+void YAPI_FUNCTION_EXPORT yapiSetCallbackThreads(int nbThreads);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiSetThreadConfig(int role, u64 cpuMask, int rtPriority, char *errmsg)
+
+  Description:
+    Configure the CPU affinity and the scheduling priority of the threads
+    started by the library for a given role, so that latency-critical I/O
+    threads can be isolated from bulk work. Threads are also named after
+    their role (yapi-usb, yapi-hub, yapi-callback, yapi-ssdp, yapi-firmware).
+
+  Parameters:
+    role       : YAPI_THREAD_USB, YAPI_THREAD_HUB, YAPI_THREAD_CALLBACK,
+                 YAPI_THREAD_DISCOVERY or YAPI_THREAD_FIRMWARE
+    cpuMask    : a bit mask of the CPUs the threads may run on (bit 0 for the
+                 first CPU), or 0 for no restriction (default)
+    rtPriority : the SCHED_FIFO priority of the threads (1 to 99), or 0 to
+                 keep the default scheduling policy (default)
+    errmsg     : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    This function must be called before yInitAPI. Real-time scheduling
+    usually requires extra privileges (CAP_SYS_NICE on Linux); when the
+    affinity or the priority cannot be applied, the thread runs with the
+    default settings and a message is logged. On Windows, rtPriority > 0
+    selects THREAD_PRIORITY_TIME_CRITICAL. CPU affinity is not available
+    on macOS.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetThreadConfig(int role, u64 cpuMask, int rtPriority, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiGetEventQueueStats(u32 *nbQueued, u32 *nbDropped, u32 *nbCoalesced, char *errmsg)
+
+  Description:
+    Get the counters of the function callback event queue since yInitAPI.
+
+  Parameters:
+    nbQueued    : a pointer to the number of events pushed by the I/O threads, or NULL
+    nbDropped   : a pointer to the number of events lost on overflow, or NULL
+    nbCoalesced : a pointer to the number of values replaced by a more recent one, or NULL
+    errmsg      : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetEventQueueStats(u32 *nbQueued, u32 *nbDropped, u32 *nbCoalesced, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    int yapiGetEventFd(char *errmsg)
+
+  Description:
+    Get a file descriptor that becomes readable whenever yapiHandleEvents
+    must be called: USB packets or network hub notifications have been
+    received, or callbacks are pending in the event queue. This makes it possible to integrate the
+    library into an external event loop (select, poll, epoll, kqueue,
+    libuv...) instead of calling yapiSleep or yapiHandleEvents periodically.
+    The descriptor is reset by yapiHandleEvents: do not read from it.
+
+  Parameters:
+    errmsg : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : the file descriptor, valid until yFreeAPI
+
+  Remarks:
+    This is an eventfd on Linux, and the read end of a pipe on other Unix
+    systems. It is not supported on Windows. Values held back by
+    yapiSetFunctionValueFilter do not make it readable, so the event loop
+    should still call yapiHandleEvents from time to time when filters are
+    used.
+ ***************************************************************************/
+int YAPI_FUNCTION_EXPORT yapiGetEventFd(char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiGetPoolStats(int pool, u32 *inUse, u32 *peak, u32 *reused, u32 *allocated, char *errmsg)
+
+  Description:
+    Get the counters of one of the memory pools used for the objects and
+    buffers allocated on every request and every USB packet.
+
+  Parameters:
+    pool      : YAPI_POOL_REQUEST, YAPI_POOL_PACKET, YAPI_POOL_IOHDL or YAPI_POOL_BUFFER
+    inUse     : a pointer to the number of items currently in use, or NULL
+    peak      : a pointer to the highest number of items in use since yInitAPI, or NULL
+    reused    : a pointer to the number of allocations served by the pool, or NULL
+    allocated : a pointer to the number of allocations that went to the heap, or NULL
+    errmsg    : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    In steady state, allocated should stop growing while reused keeps
+    increasing. For YAPI_POOL_BUFFER, the peak is the sum of the peaks of
+    each size class. Buffers larger than 64KB are not pooled nor counted.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetPoolStats(int pool, u32 *inUse, u32 *peak, u32 *reused, u32 *allocated, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiSetMemoryLimit(int subsystem, u32 limit, char *errmsg)
+
+  Description:
+    Set a soft limit on the memory held by one subsystem of the library.
+    Once the limit is reached, the buffers of the subsystem stop growing:
+    requests whose reply does not fit fail with YAPI_EXHAUSTED. For USB,
+    new requests also fail with YAPI_EXHAUSTED while the limit is exceeded,
+    but the packets of the requests already running are always received.
+
+  Parameters:
+    subsystem : YAPI_MEM_USB, YAPI_MEM_NET, YAPI_MEM_HASH or YAPI_MEM_FIRMWARE
+    limit     : the limit in bytes, or 0 for no limit (default)
+    errmsg    : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    This function can be called before yInitAPI. The hash tables are
+    mostly static and cannot refuse new entries, YAPI_MEM_HASH is
+    therefore only reported and cannot be limited.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetMemoryLimit(int subsystem, u32 limit, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiGetMemoryStats(int subsystem, u32 *used, u32 *peak, u32 *limit, char *errmsg)
+
+  Description:
+    Get the number of bytes currently held by one subsystem of the library,
+    its high-water mark and its soft limit.
+
+  Parameters:
+    subsystem : YAPI_MEM_USB, YAPI_MEM_NET, YAPI_MEM_HASH or YAPI_MEM_FIRMWARE
+    used      : a pointer to the number of bytes currently allocated, or NULL
+    peak      : a pointer to the highest number of bytes allocated so far, or NULL
+    limit     : a pointer to the soft limit set with yapiSetMemoryLimit, or NULL
+    errmsg    : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    Items kept in the free lists of the memory pools are not counted, so
+    that the usage drops back under the limit once the requests are done.
+    The free lists are bounded, see yapiGetPoolStats.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetMemoryStats(int subsystem, u32 *used, u32 *peak, u32 *limit, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiGetLockProfile(char *buffer, int maxsize, int *neededsize, int reset, char *errmsg)
+
+  Description:
+    Dump the lock contention profile of the library critical sections, as
+    text with one line per call site, sorted by decreasing wait time:
+      lock;site;acquisitions;contended;wait_us;max_wait_us;hold_us;max_hold_us
+    where lock is the place where the critical section is initialized (locks
+    of the same kind, such as per-hub locks, are aggregated) and site is the
+    place where it is entered.
+
+  Parameters:
+    buffer     : a pointer to a buffer for the profile, or NULL
+    maxsize    : the size of the buffer in bytes
+    neededsize : a pointer to the size needed for the complete profile, or NULL
+    reset      : 1 to clear the counters once they have been read
+    errmsg     : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    The profiler is only available when the library is built with
+    PROFILE_CRITICAL_SECTION defined (see ydef.h), otherwise this function
+    returns YAPI_NOT_SUPPORTED. A truncated profile is null-terminated.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiGetLockProfile(char *buffer, int maxsize, int *neededsize, int reset, char *errmsg);
+
+
+/*****************************************************************************
+  Function:
+    YRETCODE yapiSetFunctionValueFilter(YAPI_FUNCTION fundesc, int minIntervalMs, double deadband, char *errmsg)
+
+  Description:
+    Limit the rate of the value callbacks of a function. Values received
+    less than minIntervalMs after the last delivered value are held back,
+    and only the most recent one is delivered once the interval has
+    elapsed. Numeric values that differ from the last delivered value by
+    less than deadband are dropped. Filtered values never reach the event
+    queue nor the callbacks.
+
+  Parameters:
+    fundesc       : the function descriptor
+    minIntervalMs : the minimum delay between two values, in milliseconds, or 0
+    deadband      : the minimum change of a numeric value, or 0
+    errmsg        : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+  Returns:
+    on ERROR   : error code
+    on SUCCESS : YAPI_SUCCESS
+
+  Remarks:
+    Use 0 for both minIntervalMs and deadband to remove the filter. Values
+    held back are delivered by the callback threads when they are enabled
+    (see yapiSetCallbackThreads), or else by yapiHandleEvents (or yapiSleep). Values
+    replaced by a more recent one are counted as coalesced by
+    yapiGetEventQueueStats. Timed reports are not filtered.
+ ***************************************************************************/
+YRETCODE YAPI_FUNCTION_EXPORT yapiSetFunctionValueFilter(YAPI_FUNCTION fundesc, int minIntervalMs, double deadband, char *errmsg);
+
+
 
 
 /*****************************************************************************
@@ -491,6 +881,25 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiSleep(int duration_ms, char *errmsg);
 u64 YAPI_FUNCTION_EXPORT yapiGetTickCount(void);
 
 
+/*****************************************************************************
+ Function:
+ u64 yapiGetTickCountUs()
+
+ Description:
+ Return the current value of a monotone microsecond-based time counter
+
+ Returns:
+ Monotone microsecond-based time counter
+
+ Remarks:
+ The counter starts close to the number of microseconds since January 1st
+ 1970, but does not follow the steps of the system clock. yapiGetTickCount
+ is this counter divided by 1000. Notifications and timed reports are
+ stamped with this counter on arrival (see yapiGetFunctionsSnapshot).
+ ***************************************************************************/
+u64 YAPI_FUNCTION_EXPORT yapiGetTickCountUs(void);
+
+
 /*****************************************************************************
  Function:
  int yCheckLogicalName(const char *name)
@@ -548,6 +957,27 @@ u16 YAPI_FUNCTION_EXPORT yapiGetAPIVersion(const char **version,const char **api
 void YAPI_FUNCTION_EXPORT yapiSetTraceFile(const char *file);
 
 
+/*****************************************************************************
+ Function:
+ void yapiSetWarmCacheFile(const char *file)
+
+ Description:
+ Enable the warm-start cache of the device and function lists. When set,
+ the cache is loaded by yapiInitAPI, so that devices and functions seen
+ during the previous run can be resolved immediately, and it is saved
+ again by yapiFreeAPI. Cached devices are reconciled with the real ones
+ by the first enumeration of their USB port or network hub: devices
+ that are not found are silently removed.
+
+ Parameters:
+ file: the full path of the cache file to use, or NULL to disable it
+
+ Remarks:
+ This function must be called before yInitAPI.
+ ***************************************************************************/
+void YAPI_FUNCTION_EXPORT yapiSetWarmCacheFile(const char *file);
+
+
 /*****************************************************************************
  Function:
    YAPI_DEVICE yGetDevice(const char *device_str,char *errmsg)
@@ -816,6 +1246,39 @@ YRETCODE YAPI_FUNCTION_EXPORT yapiGetFunctionInfo(YAPI_FUNCTION fundesc,YAPI_DEV
 YRETCODE YAPI_FUNCTION_EXPORT yapiGetFunctionInfoEx(YAPI_FUNCTION fundesc, YAPI_DEVICE *devdesc, char *serial, char *funcId, char *baseType, char *funcName, char *funcVal, char *errmsg);
 
 
+/*****************************************************************************
+ Function:
+   int yapiGetFunctionsSnapshot(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize, char *errmsg)
+
+ Description:
+   Get the yellow-page information of all functions of a given class in a
+   single call. All records are copied under the same lock, so that they
+   form a consistent snapshot. This is much cheaper than calling
+   yGetFunctionInfo for each descriptor returned by yGetFunctionsByClass.
+
+ Parameters:
+   class_str  : the class of the functions ("Relay", "Sensor", "Function", ...),
+                or NULL for all functions except Module
+   buffer     : buffer to be filled with function records, or NULL
+   maxsize    : size in byte of buffer
+   neededsize : size in byte of buffer to pass to this function to get all functions
+   errmsg     : a pointer to a buffer of YOCTO_ERRMSG_LEN bytes to store any error message
+
+ Returns:
+   check the result with the YISERR(retcode)
+   on ERROR   : error code
+   on SUCCESS : nb of function records written into buffer
+
+ Remarks:
+   funcVal holds the raw advertised value, as returned by yGetFunctionInfo.
+   lastTimedReport is the device time of the last timed report received
+   for the function, or 0 if none has been received so far. valueArrival
+   and reportArrival are the host times (see yapiGetTickCountUs) at which
+   the last value and the last timed report were received.
+ ***************************************************************************/
+int YAPI_FUNCTION_EXPORT yapiGetFunctionsSnapshot(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize, char *errmsg);
+
+
  /*****************************************************************************
   Function:
     int yapiHTTPRequestSyncStartEx(YIOHDL *iohdl, const char *device, const char *request, int requestsize, char **reply, int *replysize, char *errmsg);
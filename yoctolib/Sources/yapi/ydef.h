@@ -294,6 +294,8 @@ typedef void *YIOHDL;
 
 
 //#define DEBUG_CRITICAL_SECTION
+// record lock contention per critical section and call site (see yapiGetLockProfile)
+//#define PROFILE_CRITICAL_SECTION
 
 #ifdef DEBUG_CRITICAL_SECTION
 #if defined(WINDOWS_API)
@@ -369,6 +371,52 @@ void yEnterCriticalSection(yCRITICAL_SECTION *cs);
 int yTryEnterCriticalSection(yCRITICAL_SECTION *cs);
 void yLeaveCriticalSection(yCRITICAL_SECTION *cs);
 void yDeleteCriticalSection(yCRITICAL_SECTION *cs);
+
+#ifdef PROFILE_CRITICAL_SECTION
+void yProfInitializeCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs);
+void yProfEnterCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs);
+int yProfTryEnterCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs);
+void yProfLeaveCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs);
+
+#define yInitializeCriticalSection(cs)  yProfInitializeCriticalSection(__FILE__,__LINE__,cs)
+#define yEnterCriticalSection(cs)       yProfEnterCriticalSection(__FILE__,__LINE__,cs)
+#define yTryEnterCriticalSection(cs)    yProfTryEnterCriticalSection(__FILE__,__LINE__,cs)
+#define yLeaveCriticalSection(cs)       yProfLeaveCriticalSection(__FILE__,__LINE__,cs)
+#endif
+#endif
+#endif
+
+// Reader/writer locks: any number of readers or a single writer.
+// Unlike critical sections, they are NOT recursive.
+#if defined(MICROCHIP_API)
+#define yRWLOCK                         u8
+#define yInitializeRWLock(rw)
+#define yEnterReadLock(rw)
+#define yLeaveReadLock(rw)
+#define yEnterWriteLock(rw)
+#define yLeaveWriteLock(rw)
+#define yDeleteRWLock(rw)
+#else
+typedef void* yRWLOCK;
+void yInitializeRWLock(yRWLOCK *rw);
+void yEnterReadLock(yRWLOCK *rw);
+void yLeaveReadLock(yRWLOCK *rw);
+void yEnterWriteLock(yRWLOCK *rw);
+void yLeaveWriteLock(yRWLOCK *rw);
+void yDeleteRWLock(yRWLOCK *rw);
+
+#if defined(PROFILE_CRITICAL_SECTION) && !defined(DEBUG_CRITICAL_SECTION)
+void yProfInitializeRWLock(const char* fileid, int lineno, yRWLOCK *rw);
+void yProfEnterReadLock(const char* fileid, int lineno, yRWLOCK *rw);
+void yProfLeaveReadLock(const char* fileid, int lineno, yRWLOCK *rw);
+void yProfEnterWriteLock(const char* fileid, int lineno, yRWLOCK *rw);
+void yProfLeaveWriteLock(const char* fileid, int lineno, yRWLOCK *rw);
+
+#define yInitializeRWLock(rw)           yProfInitializeRWLock(__FILE__,__LINE__,rw)
+#define yEnterReadLock(rw)              yProfEnterReadLock(__FILE__,__LINE__,rw)
+#define yLeaveReadLock(rw)              yProfLeaveReadLock(__FILE__,__LINE__,rw)
+#define yEnterWriteLock(rw)             yProfEnterWriteLock(__FILE__,__LINE__,rw)
+#define yLeaveWriteLock(rw)             yProfLeaveWriteLock(__FILE__,__LINE__,rw)
 #endif
 #endif
 
@@ -460,6 +508,20 @@ typedef struct {
     u8      beacon;
 } yDeviceSt;
 
+// function description, as returned by yapiGetFunctionsSnapshot
+typedef struct {
+    YAPI_FUNCTION   fundesc;
+    s16             devYdx;             // white pages index of the device, -1 if unknown
+    u16             baseType;           // YOCTO_AKA_YFUNCTION or YOCTO_AKA_YSENSOR
+    char            className[YOCTO_FUNCTION_LEN];
+    char            funcId[YOCTO_FUNCTION_LEN];
+    char            funcName[YOCTO_LOGICAL_LEN];
+    char            funcVal[YOCTO_PUBVAL_LEN];
+    double          lastTimedReport;    // device time of the last timed report, 0 if none
+    u64             valueArrival;       // host arrival time of the last value, in yapiGetTickCountUs() units
+    u64             reportArrival;      // host arrival time of the last timed report, 0 if none
+} yFunctionSnapshotSt;
+
 // definitions for USB protocl
 
 #ifndef C30
@@ -93,6 +93,9 @@ void yFifoEmptyEx(yFifoBuf *buf)
 {
     buf->datasize = 0;
     buf->head = buf->tail =  buf->buff;
+#ifndef MICROCHIP_API
+    buf->scanofs = 0;
+#endif
 }
 
 #ifdef YFIFO_USE_MUTEX
@@ -175,6 +178,9 @@ u16 yPopFifoEx(yFifoBuf *buf, u8 *data, u16 datalen)
     // remain the number of bytes really free in buffer (may be polled
     // from within interrupt handlers)
     buf->datasize -= datalen;
+#ifndef MICROCHIP_API
+    buf->scanofs = (buf->scanofs > datalen ? buf->scanofs - datalen : 0);
+#endif
 #ifdef DEBUG_FIFO
     buf->totalPopded += datalen;
 #endif
@@ -311,56 +317,108 @@ u16 yPeekContinuousFifo(yFifoBuf *buf, u8 **ptr, u16 startofs)
 #endif
 
 
+// case-insensitive comparison used by bTextCompare, only letters are folded
+static int yFifoTextEq(u8 bletter, u8 pletter)
+{
+    if (pletter >= 'A' && bletter >= 'A' && pletter <= 'z' && bletter <= 'z') {
+        return (bletter & ~32) == (pletter & ~32);
+    }
+    return bletter == pletter;
+}
+
+// Compare the fifo content at offset ofs with the pattern, handling wrap-around
+static int yFifoMatchAt(yFifoBuf *buf, u16 ofs, const u8* pattern, u16 patlen, u8 bTextCompare)
+{
+    u8 *ptr = buf->head + ofs;
+    u16 firstpart, i;
+
+    if (ptr >= YFIFOEND(buf))
+        ptr -= buf->buffsize;
+    firstpart = (u16)(YFIFOEND(buf) - ptr);
+    if (!bTextCompare) {
+        if (firstpart >= patlen)
+            return memcmp(ptr, pattern, patlen) == 0;
+        return memcmp(ptr, pattern, firstpart) == 0 &&
+            memcmp(buf->buff, pattern + firstpart, patlen - firstpart) == 0;
+    }
+    for (i = 0; i < patlen; i++) {
+        if (!yFifoTextEq(*ptr, pattern[i]))
+            return 0;
+        if (++ptr >= YFIFOEND(buf))
+            ptr = buf->buff;
+    }
+    return 1;
+}
+
 u16 ySeekFifoEx(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u16 searchlen, u8 bTextCompare)
 {
-    u8 *ptr;
-    u16 patidx;
-    u16 firstmatch = 0xffff;
+    u8  first;
+    int ofs, lastofs;
 
     // pattern bigger than our buffer size -> not found
-    if (startofs + patlen > buf->datasize) {
+    if (patlen == 0 || startofs + patlen > buf->datasize) {
         return 0xffff;
     }
-    // ajust searchlen and ptr to our buffer
-    // size and position
+    // ajust searchlen to our buffer size and position
     if (searchlen == 0 || searchlen > buf->datasize - startofs)
         searchlen = buf->datasize - startofs;
-    ptr = buf->head + startofs;
-    if (ptr >= YFIFOEND(buf))
-        ptr -= buf->buffsize;
-
-    patidx = 0;
-    while (searchlen > 0 && patidx < patlen) {
-        u16 bletter = *ptr;
-        u16 pletter = pattern[patidx];
+    if (patlen > searchlen) {
+        return 0xffff;
+    }
+    // look for the first pattern character with memchr, on the contiguous
+    // parts of the buffer, and compare the rest of the pattern on each hit
+    first = pattern[0];
+    lastofs = startofs + searchlen - patlen;
+    ofs = startofs;
+    while (ofs <= lastofs) {
+        u8 *ptr = buf->head + ofs;
+        u8 *found = NULL;
+        int len;
 
-        if (bTextCompare && pletter >= 'A' && bletter >= 'A' && pletter <= 'z' && bletter <= 'z') {
-            pletter &= ~32;
-            bletter &= ~32;
-        }
-        if (pletter == bletter) {
-            if(patidx == 0) {
-                firstmatch = startofs;
+        if (ptr >= YFIFOEND(buf))
+            ptr -= buf->buffsize;
+        len = (int)(YFIFOEND(buf) - ptr);
+        if (len > lastofs - ofs + 1)
+            len = lastofs - ofs + 1;
+        if (bTextCompare && first >= 'A' && first <= 'z') {
+            int i;
+            for (i = 0; i < len; i++) {
+                if (yFifoTextEq(ptr[i], first)) {
+                    found = ptr + i;
+                    break;
+                }
             }
-            patidx++;
-        } else if(patidx > 0) {
-            // rescan this character as first pattern character
-            patidx = 0;
+        } else {
+            found = (u8*)memchr(ptr, first, len);
+        }
+        if (found == NULL) {
+            ofs += len;
             continue;
         }
-        startofs++;
-        searchlen--;
-        ptr++;
-        if (ptr >= YFIFOEND(buf))
-            ptr -= buf->buffsize;
-
-    }
-    if (patidx == patlen) {
-        return firstmatch;
+        ofs += (int)(found - ptr);
+        if (yFifoMatchAt(buf, (u16)ofs, pattern, patlen, bTextCompare)) {
+            return (u16)ofs;
+        }
+        ofs++;
     }
     return 0xffff;
 }
 
+#ifndef MICROCHIP_API
+u16 ySeekFifoResumeEx(yFifoBuf *buf, const u8* pattern, u16 patlen, u8 bTextCompare)
+{
+    u16 res = ySeekFifoEx(buf, pattern, patlen, buf->scanofs, 0, bTextCompare);
+
+    if (res != 0xffff) {
+        buf->scanofs = res;
+    } else if (buf->datasize >= patlen && buf->datasize - patlen + 1 > buf->scanofs) {
+        // the last patlen-1 bytes may still be the beginning of a match
+        buf->scanofs = buf->datasize - patlen + 1;
+    }
+    return res;
+}
+#endif
+
 
 #ifdef YFIFO_USE_MUTEX
 
@@ -373,6 +431,16 @@ u16 ySeekFifo(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u16 s
     yFifoLeaveCS(buf);
     return res;
 }
+
+u16 ySeekFifoResume(yFifoBuf *buf, const u8* pattern, u16 patlen, u8 bTextCompare)
+{
+    u16 res;
+
+    yFifoEnterCS(buf);
+    res = ySeekFifoResumeEx(buf,pattern,patlen,bTextCompare);
+    yFifoLeaveCS(buf);
+    return res;
+}
 #endif
 
 u16 yFifoGetUsedEx(yFifoBuf *buf)
@@ -409,6 +477,112 @@ u16 yFifoGetFree(yFifoBuf *buf)
 
 #endif
 
+#ifndef MICROCHIP_API
+
+void yLFQueueInit(yLFQueue *q, u32 itemsize, u32 nbItems)
+{
+    u32 i;
+
+    YASSERT(nbItems >= 2 && (nbItems & (nbItems - 1)) == 0);
+    memset(q, 0, sizeof(yLFQueue));
+    q->itemsize = itemsize;
+    q->mask = nbItems - 1;
+    q->seq = (volatile u32 *)yMalloc(nbItems * sizeof(u32));
+    q->items = (u8 *)yMalloc(nbItems * itemsize);
+    for (i = 0; i < nbItems; i++) {
+        q->seq[i] = i;
+    }
+}
+
+void yLFQueueCleanup(yLFQueue *q)
+{
+    // yFree needs an lvalue, and seq is volatile
+    void *seq = (void *)q->seq;
+
+    if (seq) yFree(seq);
+    if (q->items) yFree(q->items);
+    memset(q, 0, sizeof(yLFQueue));
+}
+
+// return 0 if the queue is full
+int yPushLFQueue(yLFQueue *q, const void *item)
+{
+    u32 pos = yAtomicLoad32(&q->head);
+    u32 slot;
+    s32 dif;
+
+    for (;;) {
+        slot = pos & q->mask;
+        dif = (s32)(yAtomicLoad32(&q->seq[slot]) - pos);
+        if (dif == 0) {
+            // slot is free for this turn, try to reserve it
+            if (yAtomicCAS32(&q->head, pos, pos + 1)) break;
+            pos = yAtomicLoad32(&q->head);
+        } else if (dif < 0) {
+            // slot still holds the item of the previous turn
+            return 0;
+        } else {
+            pos = yAtomicLoad32(&q->head);
+        }
+    }
+    memcpy(q->items + slot * q->itemsize, item, q->itemsize);
+    yAtomicStore32(&q->seq[slot], pos + 1);
+    return 1;
+}
+
+// return 0 if the queue is empty
+int yPopLFQueue(yLFQueue *q, void *item)
+{
+    u32 pos = yAtomicLoad32(&q->tail);
+    u32 slot;
+    s32 dif;
+
+    for (;;) {
+        slot = pos & q->mask;
+        dif = (s32)(yAtomicLoad32(&q->seq[slot]) - (pos + 1));
+        if (dif == 0) {
+            if (yAtomicCAS32(&q->tail, pos, pos + 1)) break;
+            pos = yAtomicLoad32(&q->tail);
+        } else if (dif < 0) {
+            return 0;
+        } else {
+            pos = yAtomicLoad32(&q->tail);
+        }
+    }
+    if (item) {
+        memcpy(item, q->items + slot * q->itemsize, q->itemsize);
+    }
+    yAtomicStore32(&q->seq[slot], pos + q->mask + 1);
+    return 1;
+}
+
+// push an item, dropping the oldest ones if the queue is full
+// return the number of dropped items
+int yForceLFQueue(yLFQueue *q, const void *item)
+{
+    int dropped = 0;
+
+    while (!yPushLFQueue(q, item)) {
+        if (yPopLFQueue(q, NULL)) {
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+u32 yLFQueueGetUsed(yLFQueue *q)
+{
+    u32 head = yAtomicLoad32(&q->head);
+    u32 tail = yAtomicLoad32(&q->tail);
+    s32 used = (s32)(head - tail);
+
+    // head and tail are not read atomically together
+    if (used < 0) return 0;
+    return ((u32)used > q->mask + 1 ? q->mask + 1 : (u32)used);
+}
+
+#endif
+
 #ifndef REDUCE_COMMON_CODE
 void yxtoa(u32 x, char *buf, u16 len)
 {
@@ -526,4 +700,41 @@ void decodePubVal(Notification_funydx funInfo, const char *funcval, char *buffer
     buffer[i] = 0;
 }
 
+#ifndef MICROCHIP_API
+// Decode a typed notification (V2) carrying a numeric value without any
+// text conversion. Returns the PUBVAL_xxx encoding of the value, or -1 if
+// the notification does not carry a number (in which case value is untouched)
+//
+int decodePubValNumeric(Notification_funydx funInfo, const char *funcval, double *value)
+{
+    const unsigned char *p = (const unsigned char *)funcval;
+    u16     funcValType;
+    s32     numVal;
+    float   floatVal;
+
+    if(funInfo.v2.typeV2 != NOTIFY_V2_TYPEDDATA) {
+        return -1;
+    }
+    funcValType = *p++;
+    switch(funcValType) {
+        case PUBVAL_C_LONG:
+        case PUBVAL_YOCTO_FLOAT_E3:
+            // 32bit integer in little endian format or Yoctopuce 10-3 format
+            numVal = *p++;
+            numVal += (s32)*p++ << 8;
+            numVal += (s32)*p++ << 16;
+            numVal += (s32)*p++ << 24;
+            *value = (funcValType == PUBVAL_C_LONG ? (double)numVal : numVal / 1000.0);
+            return funcValType;
+        case PUBVAL_C_FLOAT:
+            // 32bit (short) float
+            memcpy(&floatVal, p, sizeof(floatVal));
+            *value = floatVal;
+            return funcValType;
+        default:
+            return -1;
+    }
+}
+#endif
+
 #endif
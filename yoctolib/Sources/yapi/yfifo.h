@@ -65,6 +65,9 @@ typedef struct {
 #ifdef YFIFO_USE_MUTEX
 	yCRITICAL_SECTION cs;
 #endif
+#ifndef MICROCHIP_API
+    u16 scanofs;        // offset where ySeekFifoResume starts, adjusted when data is popped
+#endif
 #ifdef DEBUG_FIFO
 	const char* fileid;
 	int 		line;
@@ -100,6 +103,13 @@ u16  ySeekFifoEx(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u1
 u16  yFifoGetUsedEx(yFifoBuf *buf);
 u16  yFifoGetFreeEx(yFifoBuf *buf);
 u16  yForceFifo(yFifoBuf *buf, const u8 *data, u16 datalen, u32 *absCounter);
+#ifndef MICROCHIP_API
+// Same as ySeekFifoEx on the whole fifo, but skip the bytes already scanned by
+// the previous unsuccessful call, so that waiting for a pattern while data
+// trickles in costs O(n). The fifo keeps a single cursor: use it for a single
+// pattern per fifo
+u16  ySeekFifoResumeEx(yFifoBuf *buf, const u8* pattern, u16 patlen, u8 bTextCompare);
+#endif
 
 #ifdef YFIFO_USE_MUTEX
 // mutex non-Ex function call yFifoEnterCs and yFifoLeaveCs
@@ -113,6 +123,7 @@ u16  yPopFifo(yFifoBuf *buf, u8 *data, u16 datalen);
 u16  yPeekFifo(yFifoBuf *buf, u8 *data, u16 datalen, u16 startofs);
 u16  yPeekContinuousFifo(yFifoBuf *buf, u8 **ptr,u16 startofs);
 u16  ySeekFifo(yFifoBuf *buf, const u8* pattern, u16 patlen,  u16 startofs, u16 searchlen, u8 bTextCompare);
+u16  ySeekFifoResume(yFifoBuf *buf, const u8* pattern, u16 patlen, u8 bTextCompare);
 u16  yFifoGetUsed(yFifoBuf *buf);
 u16  yFifoGetFree(yFifoBuf *buf);
 
@@ -130,8 +141,33 @@ u16  yFifoGetFree(yFifoBuf *buf);
 #define yFifoGetFree(buf)                                                   yFifoGetFreeEx(buf)
 #endif
 
+#ifndef MICROCHIP_API
+// Bounded lock-free queue of fixed-size items. Any thread can push or pop
+// without locking: each slot carries a sequence number telling whether it
+// is ready to be written or read for the current turn. nbItems must be a
+// power of two.
+typedef struct {
+    u32             itemsize;
+    u32             mask;
+    volatile u32    head;       // next position to write
+    volatile u32    tail;       // next position to read
+    volatile u32    *seq;
+    u8              *items;
+} yLFQueue;
+
+void yLFQueueInit(yLFQueue *q, u32 itemsize, u32 nbItems);
+void yLFQueueCleanup(yLFQueue *q);
+int  yPushLFQueue(yLFQueue *q, const void *item);
+int  yPopLFQueue(yLFQueue *q, void *item);
+int  yForceLFQueue(yLFQueue *q, const void *item);
+u32  yLFQueueGetUsed(yLFQueue *q);
+#endif
+
 // Misc functions needed in yapi, hubs and devices
 void yxtoa(u32 x, char *buf, u16 len);
 void decodePubVal(Notification_funydx funInfo, const char *funcval, char *buffer);
+#ifndef MICROCHIP_API
+int  decodePubValNumeric(Notification_funydx funInfo, const char *funcval, double *value);
+#endif
 
 #endif
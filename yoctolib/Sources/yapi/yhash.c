@@ -55,8 +55,8 @@ __eds__ __attribute__((far, __section__(".yfar1"))) YHashSlot yHashTable[NB_MAX_
 static YHashSlot  yHashTable[NB_MAX_HASH_ENTRIES];
 yCRITICAL_SECTION yHashMutex;
 yCRITICAL_SECTION yFreeMutex;
-yCRITICAL_SECTION yWpMutex;
-yCRITICAL_SECTION yYpMutex;
+yRWLOCK           yWpMutex;
+yRWLOCK           yYpMutex;
 #endif
 
 //#define DEBUG_YHASH
@@ -76,6 +76,60 @@ static u16 nextHashEntry = 256;
 static yBlkHdl devYdxPtr[NB_MAX_DEVICES];
 static yBlkHdl funYdxPtr[NB_MAX_DEVICES];
 
+#ifndef MICROCHIP_API
+// Host-side white pages indexes, protected by yWpMutex. Since yStrRef
+// values are dense and below NB_MAX_HASH_ENTRIES, they are used directly
+// as index. Serial numbers are unique, while logical names and urls can
+// be shared by several devices: those are chained in registration order
+// (same order as yWpListHead) through wpNameNext/wpUrlNext, indexed by
+// devYdx. As for the list walk, a lookup by name returns the last device
+// registered with that name, and a lookup by url the first one.
+static yBlkHdl wpBySerial[NB_MAX_HASH_ENTRIES];
+static yBlkHdl wpByName[NB_MAX_HASH_ENTRIES];
+static yBlkHdl wpByUrl[NB_MAX_HASH_ENTRIES];
+static yBlkHdl wpNameNext[NB_MAX_DEVICES];
+static yBlkHdl wpUrlNext[NB_MAX_DEVICES];
+static u32     wpRegSeq[NB_MAX_DEVICES];   // registration order of each devYdx
+static u32     wpRegCount = 0;
+#endif
+
+#ifndef MICROCHIP_API
+// Host-side yellow pages indexes, protected by yYpMutex. Categories are
+// indexed by name, and functions by hardware id (serial+funcId). Within
+// each category, functions sharing a funcId or a logical name are
+// chained in registration order, through arrays indexed by yBlkHdl.
+#define NB_MAX_BLK_HDL  (NB_MAX_HASH_ENTRIES*2)
+typedef struct {
+    u32     mask;
+    u32     count;
+    u32     *keys;
+    yBlkHdl *vals;
+} yBlkMap;
+static yBlkHdl ypCatByName[NB_MAX_HASH_ENTRIES];
+static yBlkMap ypByHwId;
+static yBlkMap ypByFuncId;      // key: categ name + (funcId << 16)
+static yBlkMap ypByName;        // key: categ name + (funcName << 16)
+static yBlkHdl ypEntryCat[NB_MAX_BLK_HDL];
+static yBlkHdl ypFuncIdNext[NB_MAX_BLK_HDL];
+static yBlkHdl ypNameNext[NB_MAX_BLK_HDL];
+// ypLastTimedReport (bits of the double device time) and ypReportArrival are
+// updated under the read lock, so they are accessed with 64-bit atomics
+static u64     ypLastTimedReport[NB_MAX_BLK_HDL];   // device time of the last timed report
+static u64     ypValueArrival[NB_MAX_BLK_HDL];      // host arrival time of the last value (us)
+static u64     ypReportArrival[NB_MAX_BLK_HDL];     // host arrival time of the last timed report (us)
+// Flat copy of the funYdxPtr arrays for the notification path, which
+// can only carry a 4-bit funYdx. Higher funYdx use the linked blocks.
+#define NB_FLAT_FUNYDX  16
+static yBlkHdl ypFunByYdx[NB_MAX_DEVICES][NB_FLAT_FUNYDX];
+
+// size of the static tables above, reported as YAPI_MEM_HASH
+#define YHASH_STATIC_SIZE   (sizeof(yHashTable) + sizeof(usedDevYdx) + sizeof(devYdxPtr) + sizeof(funYdxPtr) + \
+                             sizeof(wpBySerial) + sizeof(wpByName) + sizeof(wpByUrl) + sizeof(wpNameNext) + \
+                             sizeof(wpUrlNext) + sizeof(wpRegSeq) + sizeof(ypCatByName) + sizeof(ypEntryCat) + sizeof(ypFuncIdNext) + \
+                             sizeof(ypNameNext) + sizeof(ypLastTimedReport) + sizeof(ypValueArrival) + \
+                             sizeof(ypReportArrival) + sizeof(ypFunByYdx))
+#endif
+
 #ifndef MICROCHIP_API
 char SerialNumberStr[YOCTO_SERIAL_LEN] = "";
 #endif
@@ -186,6 +240,273 @@ static u16 fletcher16(const u8 *data, u16 len, u16 virtlen)
     return ((sum1 & 0xff) << 8) | (sum2 & 0xff);
 }
 
+#ifndef MICROCHIP_API
+
+// =======================================================================
+//   Host-side string intern index
+// =======================================================================
+//
+// On the host, lookups do not walk the 256 fletcher16 chains anymore.
+// Interned strings are indexed by a 32-bit hash in a power-of-two open
+// addressing table. Each slot holds the upper 16 bits of the hash and
+// yHash+1 (0 means empty), so that a slot can be published and read
+// atomically. Lookups do not take yHashMutex: a slot is only published
+// after the yHashTable entry has been filled, and entries never move.
+// When the table grows, the old one is kept until yHashFree since
+// concurrent readers may still be probing it.
+// Storage in yHashTable is unchanged, so that yStrRef handles (including
+// the YSTRREF_xxx magic values) are the same as before.
+
+#define YSTRIDX_INITIAL_SIZE    1024
+
+typedef struct _yStrIndex {
+    u32                 mask;       // number of slots - 1
+    u32                 count;      // number of used slots
+    struct _yStrIndex   *prev;      // retired table, freed by yHashFree
+    u32                 *slots;
+} yStrIndex;
+
+static yStrIndex *yStrIdx = NULL;
+
+static u32 yStrHash32(const u8 *buf, u16 len)
+{
+    u32 h = 0x9747b28c ^ len;
+    u32 k;
+
+    // murmur3 body, with byte loads to avoid alignment issues
+    while(len >= 4) {
+        k = buf[0] | ((u32)buf[1] << 8) | ((u32)buf[2] << 16) | ((u32)buf[3] << 24);
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+        buf += 4;
+        len -= 4;
+    }
+    k = 0;
+    switch(len) {
+    case 3: k ^= (u32)buf[2] << 16;
+        // fall through
+    case 2: k ^= (u32)buf[1] << 8;
+        // fall through
+    case 1: k ^= buf[0];
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+        h ^= k;
+    }
+    // final avalanche
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static yStrIndex *yStrIndexAlloc(u32 size)
+{
+    yStrIndex *idx = (yStrIndex *)yMalloc(sizeof(yStrIndex) + size * sizeof(u32));
+
+    yMemCharge(YAPI_MEM_HASH, (u32)(sizeof(yStrIndex) + size * sizeof(u32)));
+
+    idx->mask = size - 1;
+    idx->count = 0;
+    idx->prev = NULL;
+    idx->slots = (u32 *)(idx + 1);
+    memset(idx->slots, 0, size * sizeof(u32));
+    return idx;
+}
+
+static void yStrIndexFree(void)
+{
+    yStrIndex *idx = yStrIdx;
+
+    yStrIdx = NULL;
+    while(idx) {
+        yStrIndex *prev = idx->prev;
+        yMemUncharge(YAPI_MEM_HASH, (u32)(sizeof(yStrIndex) + (idx->mask + 1) * sizeof(u32)));
+        yFree(idx);
+        idx = prev;
+    }
+}
+
+// compare a zero-padded yHashTable entry with a buffer (without its trailing zeroes)
+static int yHashEntryMatch(yHash yhash, const u8 *buf, u16 len)
+{
+    const u8 *p = yHashTable[yhash].buff;
+    u16 i;
+
+    if(memcmp(p, buf, len) != 0) return 0;
+    for(i = len; i < HASH_BUF_SIZE; i++) {
+        if(p[i] != 0) return 0;
+    }
+    return 1;
+}
+
+static yHash yStrIndexLookup(yStrIndex *idx, u32 h32, const u8 *buf, u16 len)
+{
+    u32 pos = h32 & idx->mask;
+    u32 tag = h32 & 0xffff0000;
+    u32 slot;
+
+    while((slot = yAtomicLoad32(&idx->slots[pos])) != 0) {
+        if((slot & 0xffff0000) == tag) {
+            yHash yhash = (yHash)((slot & 0xffff) - 1);
+            if(yHashEntryMatch(yhash, buf, len)) {
+                return yhash;
+            }
+        }
+        pos = (pos + 1) & idx->mask;
+    }
+    return INVALID_HASH_IDX;
+}
+
+// insert a slot in a table which is not visible yet, or while holding yHashMutex
+static void yStrIndexStore(yStrIndex *idx, u32 h32, yHash yhash)
+{
+    u32 pos = h32 & idx->mask;
+
+    while(idx->slots[pos] != 0) {
+        pos = (pos + 1) & idx->mask;
+    }
+    idx->count++;
+    yAtomicStore32(&idx->slots[pos], (h32 & 0xffff0000) | (u32)(yhash + 1));
+}
+
+// This function should only be called after seizing yHashMutex
+static void yStrIndexGrow(void)
+{
+    yStrIndex *oldidx = yStrIdx;
+    yStrIndex *newidx = yStrIndexAlloc((oldidx->mask + 1) * 2);
+    u32 i, slot;
+    u16 len;
+    yHash yhash;
+
+    for(i = 0; i <= oldidx->mask; i++) {
+        slot = oldidx->slots[i];
+        if(slot == 0) continue;
+        yhash = (yHash)((slot & 0xffff) - 1);
+        len = HASH_BUF_SIZE;
+        while(len > 0 && yHashTable[yhash].buff[len-1] == 0) len--;
+        yStrIndexStore(newidx, yStrHash32(yHashTable[yhash].buff, len), yhash);
+    }
+    newidx->prev = oldidx;
+    yAtomicStorePtr(&yStrIdx, newidx);
+    HLOGF(("yStrIndex grown to %d slots\n", newidx->mask + 1));
+}
+
+#endif
+
+#ifndef MICROCHIP_API
+
+// =======================================================================
+//   Host-side u32 -> yBlkHdl map (open addressing, linear probing)
+// =======================================================================
+
+#define YBLKMAP_INITIAL_SIZE    256
+
+static u32 yBlkMapPos(const yBlkMap *map, u32 key)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6b;
+    key ^= key >> 13;
+    return key & map->mask;
+}
+
+static void yBlkMapAlloc(yBlkMap *map, u32 size)
+{
+    map->mask = size - 1;
+    map->count = 0;
+    map->keys = (u32 *)yMalloc(size * sizeof(u32));
+    map->vals = (yBlkHdl *)yMalloc(size * sizeof(yBlkHdl));
+    yMemCharge(YAPI_MEM_HASH, (u32)(size * (sizeof(u32) + sizeof(yBlkHdl))));
+    memset(map->vals, 0, size * sizeof(yBlkHdl));
+}
+
+static void yBlkMapFree(yBlkMap *map)
+{
+    if(map->keys) {
+        yFree(map->keys);
+        yFree(map->vals);
+        yMemUncharge(YAPI_MEM_HASH, (u32)((map->mask + 1) * (sizeof(u32) + sizeof(yBlkHdl))));
+    }
+    map->keys = NULL;
+    map->vals = NULL;
+}
+
+static yBlkHdl yBlkMapGet(const yBlkMap *map, u32 key)
+{
+    u32 pos = yBlkMapPos(map, key);
+
+    while(map->vals[pos] != INVALID_BLK_HDL) {
+        if(map->keys[pos] == key) {
+            return map->vals[pos];
+        }
+        pos = (pos + 1) & map->mask;
+    }
+    return INVALID_BLK_HDL;
+}
+
+static void yBlkMapRemoveAt(yBlkMap *map, u32 pos)
+{
+    u32 next = pos, ideal;
+
+    // backward shift deletion, so that no tombstone is needed
+    map->vals[pos] = INVALID_BLK_HDL;
+    map->count--;
+    for(;;) {
+        next = (next + 1) & map->mask;
+        if(map->vals[next] == INVALID_BLK_HDL) break;
+        ideal = yBlkMapPos(map, map->keys[next]);
+        if(pos <= next ? (pos < ideal && ideal <= next) : (pos < ideal || ideal <= next)) {
+            continue;
+        }
+        map->keys[pos] = map->keys[next];
+        map->vals[pos] = map->vals[next];
+        map->vals[next] = INVALID_BLK_HDL;
+        pos = next;
+    }
+}
+
+// set the value of a key, or remove the key when val is INVALID_BLK_HDL
+static void yBlkMapSet(yBlkMap *map, u32 key, yBlkHdl val)
+{
+    u32 pos, i;
+
+    if(val != INVALID_BLK_HDL && (map->count + 1) * 2 > map->mask + 1) {
+        yBlkMap old = *map;
+        yBlkMapAlloc(map, (old.mask + 1) * 2);
+        for(i = 0; i <= old.mask; i++) {
+            if(old.vals[i] != INVALID_BLK_HDL) {
+                yBlkMapSet(map, old.keys[i], old.vals[i]);
+            }
+        }
+        yBlkMapFree(&old);
+    }
+    pos = yBlkMapPos(map, key);
+    while(map->vals[pos] != INVALID_BLK_HDL) {
+        if(map->keys[pos] == key) {
+            if(val == INVALID_BLK_HDL) {
+                yBlkMapRemoveAt(map, pos);
+            } else {
+                map->vals[pos] = val;
+            }
+            return;
+        }
+        pos = (pos + 1) & map->mask;
+    }
+    if(val != INVALID_BLK_HDL) {
+        map->keys[pos] = key;
+        map->vals[pos] = val;
+        map->count++;
+    }
+}
+
+#endif
+
 void yHashInit(void)
 {
     yStrRef empty, Module, module, HubPort,Sensor;
@@ -202,8 +523,22 @@ void yHashInit(void)
     memset((u8 *)usedDevYdx, 0, sizeof(usedDevYdx));
     yInitializeCriticalSection(&yHashMutex);
     yInitializeCriticalSection(&yFreeMutex);
-    yInitializeCriticalSection(&yWpMutex);
-    yInitializeCriticalSection(&yYpMutex);
+    yInitializeRWLock(&yWpMutex);
+    yInitializeRWLock(&yYpMutex);
+    yStrIndexFree();
+    yStrIdx = yStrIndexAlloc(YSTRIDX_INITIAL_SIZE);
+    yMemCharge(YAPI_MEM_HASH, (u32)YHASH_STATIC_SIZE);
+    memset(wpBySerial, 0, sizeof(wpBySerial));
+    memset(wpByName, 0, sizeof(wpByName));
+    memset(wpByUrl, 0, sizeof(wpByUrl));
+    memset(ypCatByName, 0, sizeof(ypCatByName));
+    memset(ypFunByYdx, 0, sizeof(ypFunByYdx));
+    yBlkMapFree(&ypByHwId);
+    yBlkMapFree(&ypByFuncId);
+    yBlkMapFree(&ypByName);
+    yBlkMapAlloc(&ypByHwId, YBLKMAP_INITIAL_SIZE);
+    yBlkMapAlloc(&ypByFuncId, YBLKMAP_INITIAL_SIZE);
+    yBlkMapAlloc(&ypByName, YBLKMAP_INITIAL_SIZE);
 #endif
 
     // Always init hast table with empty string and Module string
@@ -234,6 +569,9 @@ void yHashInit(void)
     YC(yYpListHead).blkId   = YBLKID_YPCATEG;
     YC(yYpListHead).name    = YSTRREF_MODULE_STRING;
     YC(yYpListHead).entries = INVALID_BLK_HDL;
+#ifndef MICROCHIP_API
+    ypCatByName[YSTRREF_MODULE_STRING] = yYpListHead;
+#endif
 }
 
 #ifndef MICROCHIP_API
@@ -242,11 +580,18 @@ void yHashFree(void)
     HLOGF(("yHashFree\n"));
     yDeleteCriticalSection(&yHashMutex);
     yDeleteCriticalSection(&yFreeMutex);
-    yDeleteCriticalSection(&yWpMutex);
-    yDeleteCriticalSection(&yYpMutex);
+    yDeleteRWLock(&yWpMutex);
+    yDeleteRWLock(&yYpMutex);
+    yStrIndexFree();
+    yBlkMapFree(&ypByHwId);
+    yBlkMapFree(&ypByFuncId);
+    yBlkMapFree(&ypByName);
+    yMemUncharge(YAPI_MEM_HASH, (u32)YHASH_STATIC_SIZE);
 }
 #endif
 
+#ifdef MICROCHIP_API
+
 static yHash yHashPut(const u8 *buf, u16 len, u8 testonly)
 {
     u16     hash,i;
@@ -309,6 +654,59 @@ exit_ok:
     return yhash;
 }
 
+#else
+
+static yHash yHashPut(const u8 *buf, u16 len, u8 testonly)
+{
+    u16     i, hash, fulllen = len;
+    u32     h32;
+    yHash   yhash;
+    u8      *p;
+
+    // the trailing zeroes are implied by the zero-padding
+    while(len > 0 && buf[len-1] == 0) len--;
+    h32 = yStrHash32(buf, len);
+
+    // lock-free lookup first
+    yhash = yStrIndexLookup((yStrIndex *)yAtomicLoadPtr(&yStrIdx), h32, buf, len);
+    if(yhash != INVALID_HASH_IDX) {
+        HLOGF(("yHash found at 0x%x\n", yhash));
+        return yhash;
+    }
+    if(testonly) {
+        HLOGF(("yHash entry not found\n"));
+        return INVALID_HASH_IDX;
+    }
+
+    yEnterCriticalSection(&yHashMutex);
+    // the string may have been added by another thread in the meantime
+    yhash = yStrIndexLookup(yStrIdx, h32, buf, len);
+    if(yhash == INVALID_HASH_IDX) {
+        // use the same slot allocation as the device, so that
+        // the yStrRef values are unchanged
+        hash = fletcher16(buf, fulllen, HASH_BUF_SIZE);
+        yhash = hash & 0xff;
+        if(yHashTable[yhash].next != 0) {
+            YASSERT(nextHashEntry < NB_MAX_HASH_ENTRIES);
+            yhash = nextHashEntry++;
+        }
+        yHashTable[yhash].hash = hash;
+        yHashTable[yhash].next = -1;
+        p = yHashTable[yhash].buff;
+        for(i = 0; i < len; i++) p[i] = buf[i];
+        while(i < HASH_BUF_SIZE) p[i++] = 0;
+        if((yStrIdx->count + 1) * 2 > yStrIdx->mask + 1) {
+            yStrIndexGrow();
+        }
+        yStrIndexStore(yStrIdx, h32, yhash);
+        HLOGF(("yHash added at 0x%x\n", yhash));
+    }
+    yLeaveCriticalSection(&yHashMutex);
+    return yhash;
+}
+
+#endif
+
 yHash yHashPutBuf(const u8 *buf, u16 len)
 {
     if(len > HASH_BUF_SIZE) len = HASH_BUF_SIZE;
@@ -686,6 +1084,83 @@ static void ypUnregister(yStrRef serial);//forward declaration
 static int wpLockCount = 0;
 static int wpSomethingUnregistered = 0;
 
+#ifndef MICROCHIP_API
+// insert hdl in the chain of key, keeping the chain in registration order
+static void wpIndexAdd(yBlkHdl *heads, yBlkHdl *next, yHash key, yBlkHdl hdl)
+{
+    yBlkHdl *p;
+    u32     seq = wpRegSeq[WP(hdl).devYdx];
+
+    if(key < 0 || key >= NB_MAX_HASH_ENTRIES) return;
+    p = &heads[key];
+    while(*p != INVALID_BLK_HDL && wpRegSeq[WP(*p).devYdx] < seq) {
+        p = &next[WP(*p).devYdx];
+    }
+    next[WP(hdl).devYdx] = *p;
+    *p = hdl;
+}
+
+static void wpIndexRemove(yBlkHdl *heads, yBlkHdl *next, yHash key, yBlkHdl hdl)
+{
+    yBlkHdl *p;
+
+    if(key < 0 || key >= NB_MAX_HASH_ENTRIES) return;
+    p = &heads[key];
+    while(*p != INVALID_BLK_HDL) {
+        if(*p == hdl) {
+            *p = next[WP(hdl).devYdx];
+            break;
+        }
+        p = &next[WP(*p).devYdx];
+    }
+}
+#endif
+
+// This function should only be called after seizing yWpMutex
+static yBlkHdl wpFindBySerial(yStrRef serial)
+{
+#ifndef MICROCHIP_API
+    if(serial < 0 || serial >= NB_MAX_HASH_ENTRIES)
+        return INVALID_BLK_HDL;
+    return wpBySerial[serial];
+#else
+    yBlkHdl hdl = yWpListHead;
+    while(hdl != INVALID_BLK_HDL) {
+        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
+        if(WP(hdl).serial == serial) break;
+        hdl = WP(hdl).nextPtr;
+    }
+    return hdl;
+#endif
+}
+
+// Return the first device registered with this logical name, or the last one
+// if last is set. This function should only be called after seizing yWpMutex
+static yBlkHdl wpFindByName(yStrRef name, int last)
+{
+    yBlkHdl hdl, res = INVALID_BLK_HDL;
+
+#ifndef MICROCHIP_API
+    if(name < 0 || name >= NB_MAX_HASH_ENTRIES)
+        return INVALID_BLK_HDL;
+    for(hdl = wpByName[name]; hdl != INVALID_BLK_HDL; hdl = wpNameNext[WP(hdl).devYdx]) {
+        res = hdl;
+        if(!last) break;
+    }
+#else
+    hdl = yWpListHead;
+    while(hdl != INVALID_BLK_HDL) {
+        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
+        if(WP(hdl).name == name) {
+            res = hdl;
+            if(!last) break;
+        }
+        hdl = WP(hdl).nextPtr;
+    }
+#endif
+    return res;
+}
+
 static void wpExecuteUnregisterUnsec(void)
 {
     yBlkHdl  prev = INVALID_BLK_HDL, next;
@@ -717,6 +1192,11 @@ static void wpExecuteUnregisterUnsec(void)
 
             // first remove YP entry
             ypUnregister(WP(hdl).serial);
+#ifndef MICROCHIP_API
+            wpBySerial[WP(hdl).serial] = INVALID_BLK_HDL;
+            wpIndexRemove(wpByName, wpNameNext, WP(hdl).name, hdl);
+            wpIndexRemove(wpByUrl, wpUrlNext, WP(hdl).url, hdl);
+#endif
             // entry mark as to remove
             if(prev == INVALID_BLK_HDL) {
                 yWpListHead = next;
@@ -734,6 +1214,7 @@ static void wpExecuteUnregisterUnsec(void)
             funYdxPtr[devYdx] = INVALID_BLK_HDL;
             devYdxPtr[devYdx] = INVALID_BLK_HDL;
 #ifndef MICROCHIP_API
+            memset(ypFunByYdx[devYdx], 0, sizeof(ypFunByYdx[devYdx]));
             if((unsigned) nextDevYdx > devYdx) {
                 nextDevYdx = devYdx;
             }
@@ -751,47 +1232,60 @@ static void wpExecuteUnregisterUnsec(void)
 
 #ifndef DEBUG_WP_LOCK
 
+// wpLockCount is updated atomically under a read lock, so that concurrent
+// user threads do not serialize. wpMarkForUnregister tests it under the
+// write lock, and the write lock is only needed here to flush pending
+// unregistrations.
 void wpPreventUnregisterEx(void)
 {
-    yEnterCriticalSection(&yWpMutex);
-    YASSERT(wpLockCount < 128);
-    wpLockCount++;
-    yLeaveCriticalSection(&yWpMutex);
+    int lockCount;
+
+    yEnterReadLock(&yWpMutex);
+    lockCount = (int)yAtomicAdd32(&wpLockCount, 1);
+    YASSERT(lockCount <= 128);
+    yLeaveReadLock(&yWpMutex);
 }
 
 void wpAllowUnregisterEx(void)
 {
-    yEnterCriticalSection(&yWpMutex);
-    YASSERT(wpLockCount > 0);
-    wpLockCount--;
-    if(wpSomethingUnregistered && !wpLockCount) {
-        wpExecuteUnregisterUnsec();
-        wpSomethingUnregistered = 0;
+    int lockCount, mustFlush;
+
+    yEnterReadLock(&yWpMutex);
+    lockCount = (int)yAtomicAdd32(&wpLockCount, -1);
+    YASSERT(lockCount >= 0);
+    mustFlush = (lockCount == 0 && wpSomethingUnregistered);
+    yLeaveReadLock(&yWpMutex);
+    if(mustFlush) {
+        yEnterWriteLock(&yWpMutex);
+        if(wpSomethingUnregistered && !wpLockCount) {
+            wpExecuteUnregisterUnsec();
+            wpSomethingUnregistered = 0;
+        }
+        yLeaveWriteLock(&yWpMutex);
     }
-    yLeaveCriticalSection(&yWpMutex);
 }
 
 #else
 
 void wpPreventUnregisterDbg(const char *file, u32 line)
 {
-    yEnterCriticalSection(&yWpMutex);
+    yEnterWriteLock(&yWpMutex);
     dbglog("wpPreventUnregisterDbg: %s:%d\n",file,line);
     YASSERT(wpLockCount < 128);
     wpLockCount++;
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveWriteLock(&yWpMutex);
 }
 
 void wpAllowUnregisterDbg(const char *file, u32 line)
 {
-    yEnterCriticalSection(&yWpMutex);
+    yEnterWriteLock(&yWpMutex);
     dbglog("wpAllowUnregisterDbg: %s:%d\n",file,line);
     YASSERT(wpLockCount > 0);
     wpLockCount--;
     if(wpSomethingUnregistered && !wpLockCount) {
         wpExecuteUnregisterUnsec();
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveWriteLock(&yWpMutex);
 }
 
 #endif
@@ -807,17 +1301,23 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
     yBlkHdl  hdl;
     int      changed=0;
 
-    yEnterCriticalSection(&yWpMutex);
+    yEnterWriteLock(&yWpMutex);
 
     YASSERT(devUrl != INVALID_HASH_IDX);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == serial) break;
-        prev = hdl;
-        hdl = WP(prev).nextPtr;
+    hdl = wpFindBySerial(serial);
+#ifndef MICROCHIP_API
+    if(hdl != INVALID_BLK_HDL && (WP(hdl).flags & YWP_FROM_CACHE)) {
+        // first real registration of a device restored from the warm-start cache
+        WP(hdl).flags &= ~YWP_FROM_CACHE;
+        changed = 2;
     }
+#endif
     if(hdl == INVALID_BLK_HDL) {
+        // new entry is appended at the end of the list
+        prev = yWpListHead;
+        while(prev != INVALID_BLK_HDL && WP(prev).nextPtr != INVALID_BLK_HDL) {
+            prev = WP(prev).nextPtr;
+        }
         hdl = yBlkAlloc();
         changed = 2;
 #ifndef MICROCHIP_API
@@ -849,6 +1349,12 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
         } else {
             WP(prev).nextPtr = hdl;
         }
+#ifndef MICROCHIP_API
+        wpRegSeq[devYdx] = wpRegCount++;
+        wpBySerial[serial] = hdl;
+        wpIndexAdd(wpByName, wpNameNext, WP(hdl).name, hdl);
+        wpIndexAdd(wpByUrl, wpUrlNext, devUrl, hdl);
+#endif
 #ifdef MICROCHIP_API
     } else if(devYdx != -1 && WP(hdl).devYdx != devYdx) {
         // allow change of devYdx based on hub role
@@ -865,11 +1371,21 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
     if(logicalName != INVALID_HASH_IDX)  {
         if(WP(hdl).name != logicalName){
             if(changed==0) changed=1;
+#ifndef MICROCHIP_API
+            wpIndexRemove(wpByName, wpNameNext, WP(hdl).name, hdl);
+            wpIndexAdd(wpByName, wpNameNext, logicalName, hdl);
+#endif
             WP(hdl).name = logicalName;
         }
     }
     if(productName != INVALID_HASH_IDX) WP(hdl).product = productName;
     if(productId != 0)                  WP(hdl).devid   = productId;
+#ifndef MICROCHIP_API
+    if(WP(hdl).url != devUrl) {
+        wpIndexRemove(wpByUrl, wpUrlNext, WP(hdl).url, hdl);
+        wpIndexAdd(wpByUrl, wpUrlNext, devUrl, hdl);
+    }
+#endif
     WP(hdl).url     = devUrl;
     if(beacon >= 0) {
         WP(hdl).flags = (beacon > 0 ? YWP_BEACON_ON : 0);
@@ -892,7 +1408,7 @@ int wpRegister(int devYdx, yStrRef serial, yStrRef logicalName, yStrRef productN
     }
 #endif
 
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveWriteLock(&yWpMutex);
     return changed;
 }
 
@@ -902,7 +1418,7 @@ yStrRef wpGetAttribute(yBlkHdl hdl, yWPAttribute attridx)
 {
     yStrRef res = YSTRREF_EMPTY_STRING;
 
-    yEnterCriticalSection(&yWpMutex);
+    yEnterReadLock(&yWpMutex);
     if(WP(hdl).blkId == YBLKID_WPENTRY) {
         switch(attridx) {
         case Y_WP_SERIALNUMBER: res = WP(hdl).serial; break;
@@ -914,48 +1430,42 @@ yStrRef wpGetAttribute(yBlkHdl hdl, yWPAttribute attridx)
         case Y_WP_INDEX:        res = WP(hdl).devYdx; break;
         }
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return res;
 }
 
 void wpGetSerial(yBlkHdl hdl, char *serial)
 {
-    yEnterCriticalSection(&yWpMutex);
+    yEnterReadLock(&yWpMutex);
     if(WP(hdl).blkId == YBLKID_WPENTRY) {
         yHashGetStr(WP(hdl).serial, serial, YOCTO_SERIAL_LEN);
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 }
 
 void wpGetLogicalName(yBlkHdl hdl, char *logicalName)
 {
-    yEnterCriticalSection(&yWpMutex);
+    yEnterReadLock(&yWpMutex);
     if(WP(hdl).blkId == YBLKID_WPENTRY) {
         yHashGetStr(WP(hdl).name, logicalName, YOCTO_LOGICAL_LEN);
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 }
 
 int wpMarkForUnregister(yStrRef serial)
 {
-    yBlkHdl  next;
     yBlkHdl  hdl;
     int      retval=0;
-    yEnterCriticalSection(&yWpMutex);
+    yEnterWriteLock(&yWpMutex);
 
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        next = WP(hdl).nextPtr;
-        if(WP(hdl).serial == serial) {
-            if( (WP(hdl).flags & YWP_MARK_FOR_UNREGISTER)==0 ) {
-                WP(hdl).flags |= YWP_MARK_FOR_UNREGISTER;
-                wpSomethingUnregistered = 1;
-                retval = 1;
-            }
-            break;
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        if( (WP(hdl).flags & YWP_MARK_FOR_UNREGISTER)==0 ) {
+            WP(hdl).flags |= YWP_MARK_FOR_UNREGISTER;
+            wpSomethingUnregistered = 1;
+            retval = 1;
         }
-        hdl = next;
     }
 
 #ifdef  DEBUG_WP
@@ -977,7 +1487,7 @@ int wpMarkForUnregister(yStrRef serial)
     }
 #endif
 
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveWriteLock(&yWpMutex);
     return retval;
 }
 
@@ -986,48 +1496,90 @@ u16 wpEntryCount(void)
     return yBlkListLength(yWpListHead);
 }
 
-int wpGetDevYdx(yStrRef serial)
+#ifndef MICROCHIP_API
+// Mark an entry as restored from the warm-start cache (until wpRegister confirms it)
+void wpSetFromCache(yStrRef serial)
 {
     yBlkHdl hdl;
-    int     res = -1;
 
-    yEnterCriticalSection(&yWpMutex);
+    yEnterWriteLock(&yWpMutex);
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        WP(hdl).flags |= YWP_FROM_CACHE;
+    }
+    yLeaveWriteLock(&yWpMutex);
+}
+
+int wpIsFromCache(yStrRef serial)
+{
+    yBlkHdl hdl;
+    int     res = 0;
+
+    yEnterReadLock(&yWpMutex);
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        res = ((WP(hdl).flags & YWP_FROM_CACHE) != 0);
+    }
+    yLeaveReadLock(&yWpMutex);
+    return res;
+}
+
+// return the serial and url of all entries restored from the warm-start cache
+// that have not yet been confirmed
+int wpGetCachedDevices(yStrRef *serials, yUrlRef *urls, int sizeInStrRef)
+{
+    yBlkHdl hdl;
+    int     count=0;
+
+    yEnterReadLock(&yWpMutex);
     hdl = yWpListHead;
     while(hdl != INVALID_BLK_HDL) {
         YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == serial) {
-            res = WP(hdl).devYdx;
-            break;
+        if(WP(hdl).flags & YWP_FROM_CACHE) {
+            if(count < sizeInStrRef) {
+                serials[count] = WP(hdl).serial;
+                urls[count] = WP(hdl).url;
+            }
+            count++;
         }
         hdl = WP(hdl).nextPtr;
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
+
+    return count;
+}
+#endif
+
+int wpGetDevYdx(yStrRef serial)
+{
+    yBlkHdl hdl;
+    int     res = -1;
+
+    yEnterReadLock(&yWpMutex);
+    hdl = wpFindBySerial(serial);
+    if(hdl != INVALID_BLK_HDL) {
+        res = WP(hdl).devYdx;
+    }
+    yLeaveReadLock(&yWpMutex);
 
     return res;
 }
 
 YAPI_DEVICE wpSearchEx(yStrRef strref)
 {
-    yBlkHdl hdl,byname;
+    yBlkHdl hdl;
     YAPI_DEVICE res = -1;
 
-    byname = INVALID_BLK_HDL;
-
-    yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == strref) {
-            res = strref;
-            break;
+    yEnterReadLock(&yWpMutex);
+    if(wpFindBySerial(strref) != INVALID_BLK_HDL) {
+        res = strref;
+    } else {
+        hdl = wpFindByName(strref, 1);
+        if(hdl != INVALID_BLK_HDL) {
+            res = WP(hdl).serial;
         }
-        if(WP(hdl).name == strref) byname = hdl;
-        hdl = WP(hdl).nextPtr;
     }
-    if(hdl == INVALID_BLK_HDL && byname != INVALID_BLK_HDL) {
-        res = WP(byname).serial;
-    }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return res;
 }
@@ -1049,17 +1601,12 @@ YAPI_DEVICE wpSearchByNameHash(yStrRef strref)
     if(strref == INVALID_HASH_IDX)
         return -1;
 
-    yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).name == strref) {
-            res = WP(hdl).serial;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    yEnterReadLock(&yWpMutex);
+    hdl = wpFindByName(strref, 0);
+    if(hdl != INVALID_BLK_HDL) {
+        res = WP(hdl).serial;
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return res;
 }
@@ -1075,17 +1622,12 @@ YAPI_DEVICE wpSearchByUrl(const char *host, const char *rootUrl)
     apiref = yHashUrl(host, rootUrl, 1,NULL);
     if(apiref == INVALID_HASH_IDX) return -1;
 
-    yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).url == apiref) {
-            res = WP(hdl).serial;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    yEnterReadLock(&yWpMutex);
+    hdl = wpByUrl[apiref];
+    if(hdl != INVALID_BLK_HDL) {
+        res = WP(hdl).serial;
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return res;
 }
@@ -1097,7 +1639,7 @@ int wpGetAllDevUsingHubUrl( yUrlRef hubUrl, yStrRef *buffer,int sizeInStrRef)
     yAbsUrl hubAbsUrl;
     yHashGetBuf(hubUrl, (u8 *)&hubAbsUrl, sizeof(hubAbsUrl));
 
-    yEnterCriticalSection(&yWpMutex);
+    yEnterReadLock(&yWpMutex);
     hdl = yWpListHead;
     while(hdl != INVALID_BLK_HDL) {
         yAbsUrl absurl;
@@ -1114,7 +1656,7 @@ int wpGetAllDevUsingHubUrl( yUrlRef hubUrl, yStrRef *buffer,int sizeInStrRef)
         }
         hdl = WP(hdl).nextPtr;
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return count;
 }
@@ -1125,19 +1667,12 @@ yUrlRef wpGetDeviceUrlRef(YAPI_DEVICE devdesc)
     yBlkHdl  hdl;
     yUrlRef  urlref = INVALID_HASH_IDX;
 
-    yEnterCriticalSection(&yWpMutex);
-
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            urlref=WP(hdl).url;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    yEnterReadLock(&yWpMutex);
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        urlref=WP(hdl).url;
     }
-
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return urlref;
 }
@@ -1151,19 +1686,14 @@ int wpGetDeviceUrl(YAPI_DEVICE devdesc, char *roothubserial, char *request, int
     char     serial[YOCTO_SERIAL_LEN];
     int      fullsize, len,idx;
 
-    yEnterCriticalSection(&yWpMutex);
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            hubref = WP(hdl).url;
-            // store device serial;
-            strref = WP(hdl).serial;
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    yEnterReadLock(&yWpMutex);
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        hubref = WP(hdl).url;
+        // store device serial;
+        strref = WP(hdl).serial;
     }
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
     if(hubref == INVALID_HASH_IDX)
         return -1;
 
@@ -1181,17 +1711,14 @@ int wpGetDeviceUrl(YAPI_DEVICE devdesc, char *roothubserial, char *request, int
         // search white pages by url
         hubref = yHashTestBuf((u8 *)&huburl, sizeof(huburl));
         strref = INVALID_HASH_IDX;
-        yEnterCriticalSection(&yWpMutex);
-        hdl = yWpListHead;
-        while(hdl != INVALID_BLK_HDL) {
-            YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-            if(WP(hdl).url == hubref) {
+        if(hubref != INVALID_HASH_IDX) {
+            yEnterReadLock(&yWpMutex);
+            hdl = wpByUrl[hubref];
+            if(hdl != INVALID_BLK_HDL) {
                 strref = WP(hdl).serial;
-                break;
             }
-            hdl = WP(hdl).nextPtr;
+            yLeaveReadLock(&yWpMutex);
         }
-        yLeaveCriticalSection(&yWpMutex);
         if(strref == INVALID_HASH_IDX) return -1;
     }
 
@@ -1242,24 +1769,19 @@ int wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char
 {
     yBlkHdl  hdl;
 
-    yEnterCriticalSection(&yWpMutex);
+    yEnterReadLock(&yWpMutex);
 
-    hdl = yWpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-        if(WP(hdl).serial == (u16)devdesc) {
-            // entry found
-            if(deviceid)    *deviceid = WP(hdl).devid;
-            if(productname) yHashGetStr(WP(hdl).product, productname, YOCTO_PRODUCTNAME_LEN);
-            if(serial)      yHashGetStr(WP(hdl).serial, serial, YOCTO_SERIAL_LEN);
-            if(logicalname) yHashGetStr(WP(hdl).name, logicalname, YOCTO_LOGICAL_LEN);
-            if(beacon)      *beacon = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0);
-            break;
-        }
-        hdl = WP(hdl).nextPtr;
+    hdl = wpFindBySerial((u16)devdesc);
+    if(hdl != INVALID_BLK_HDL) {
+        // entry found
+        if(deviceid)    *deviceid = WP(hdl).devid;
+        if(productname) yHashGetStr(WP(hdl).product, productname, YOCTO_PRODUCTNAME_LEN);
+        if(serial)      yHashGetStr(WP(hdl).serial, serial, YOCTO_SERIAL_LEN);
+        if(logicalname) yHashGetStr(WP(hdl).name, logicalname, YOCTO_LOGICAL_LEN);
+        if(beacon)      *beacon = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0);
     }
 
-    yLeaveCriticalSection(&yWpMutex);
+    yLeaveReadLock(&yWpMutex);
 
     return (hdl != INVALID_BLK_HDL ? 0 : -1);
 }
@@ -1270,6 +1792,65 @@ int wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char
 //   Yellow pages support
 // =======================================================================
 
+#ifndef MICROCHIP_API
+
+#define YP_KEY(categ,ref)           ((u16)(categ) | ((u32)(u16)(ref) << 16))
+#define YP_IS_ABSTRACT(hdl,abstract) ((abstract) == YOCTO_AKA_YFUNCTION || YP(hdl).blkId == YBLKID_YPENTRY + (abstract))
+
+// This function should only be called after seizing yYpMutex
+static void ypChainAdd(yBlkMap *map, yBlkHdl *next, u32 key, yBlkHdl hdl)
+{
+    yBlkHdl last = yBlkMapGet(map, key);
+
+    next[hdl] = INVALID_BLK_HDL;
+    if(last == INVALID_BLK_HDL) {
+        yBlkMapSet(map, key, hdl);
+        return;
+    }
+    while(next[last] != INVALID_BLK_HDL) {
+        last = next[last];
+    }
+    next[last] = hdl;
+}
+
+// This function should only be called after seizing yYpMutex
+static void ypChainRemove(yBlkMap *map, yBlkHdl *next, u32 key, yBlkHdl hdl)
+{
+    yBlkHdl prev = INVALID_BLK_HDL;
+    yBlkHdl cur = yBlkMapGet(map, key);
+
+    while(cur != INVALID_BLK_HDL && cur != hdl) {
+        prev = cur;
+        cur = next[cur];
+    }
+    if(cur == INVALID_BLK_HDL) return;
+    if(prev == INVALID_BLK_HDL) {
+        yBlkMapSet(map, key, next[hdl]);
+    } else {
+        next[prev] = next[hdl];
+    }
+}
+
+#endif
+
+// This function should only be called after seizing yYpMutex
+static yBlkHdl ypFindCategory(yStrRef categ)
+{
+#ifndef MICROCHIP_API
+    if(categ < 0 || categ >= NB_MAX_HASH_ENTRIES)
+        return INVALID_BLK_HDL;
+    return ypCatByName[categ];
+#else
+    yBlkHdl hdl = yYpListHead;
+    while(hdl != INVALID_BLK_HDL) {
+        YASSERT(YC(hdl).blkId == YBLKID_YPCATEG);
+        if(YC(hdl).name == categ) break;
+        hdl = YC(hdl).nextPtr;
+    }
+    return hdl;
+#endif
+}
+
 // return 1 on change 0 if value are the same as the cache
 int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName, int funClass, int funYdx, const char *funcVal)
 {
@@ -1280,18 +1861,24 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
     u16      i, cnt;
     int      devYdx, changed=0;
     const u16 *funcValWords = (const u16 *)funcVal;
+#ifndef MICROCHIP_API
+    u64      arrival = yapiGetTickCountUs();
+#endif
 
-    yEnterCriticalSection(&yYpMutex);
+    // resolve devYdx first: yWpMutex must never be taken while holding
+    // yYpMutex, since wpExecuteUnregisterUnsec does the opposite
+    devYdx = wpGetDevYdx(serial);
+
+    yEnterWriteLock(&yYpMutex);
 
     // locate category node
-    hdl = yYpListHead;
-    while(hdl != INVALID_BLK_HDL) {
-        YASSERT(YC(hdl).blkId == YBLKID_YPCATEG);
-        if(YC(hdl).name == categ) break;
-        prev = hdl;
-        hdl = YC(prev).nextPtr;
-    }
+    hdl = ypFindCategory(categ);
     if(hdl == INVALID_BLK_HDL) {
+        // new category is appended at the end of the list
+        prev = yYpListHead;
+        while(prev != INVALID_BLK_HDL && YC(prev).nextPtr != INVALID_BLK_HDL) {
+            prev = YC(prev).nextPtr;
+        }
         hdl = yBlkAlloc();
         YC(hdl).catYdx  = nextCatYdx++;
         YC(hdl).blkId   = YBLKID_YPCATEG;
@@ -1302,11 +1889,27 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         } else {
             YC(prev).nextPtr = hdl;
         }
+#ifndef MICROCHIP_API
+        ypCatByName[categ] = hdl;
+#endif
     }
     cat_hdl = hdl;
 
     // locate entry node
     prev = INVALID_BLK_HDL;
+#ifndef MICROCHIP_API
+    hdl = yBlkMapGet(&ypByHwId, YP_KEY(serial, funcId));
+    if(hdl != INVALID_BLK_HDL && ypEntryCat[hdl] != cat_hdl) {
+        // should never happen, the category is derived from the funcId
+        hdl = INVALID_BLK_HDL;
+    }
+    if(hdl == INVALID_BLK_HDL) {
+        prev = YC(cat_hdl).entries;
+        while(prev != INVALID_BLK_HDL && YP(prev).nextPtr != INVALID_BLK_HDL) {
+            prev = YP(prev).nextPtr;
+        }
+    }
+#else
     hdl = YC(cat_hdl).entries;
     while(hdl != INVALID_BLK_HDL) {
         YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
@@ -1314,6 +1917,7 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         prev = hdl;
         hdl = YP(prev).nextPtr;
     }
+#endif
     if(hdl == INVALID_BLK_HDL) {
         changed = 1; // new entry-> changed
         hdl = yBlkAlloc();
@@ -1333,10 +1937,23 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         } else {
             YP(prev).nextPtr = hdl;
         }
+#ifndef MICROCHIP_API
+        ypEntryCat[hdl] = cat_hdl;
+        ypLastTimedReport[hdl] = 0;
+        ypValueArrival[hdl] = 0;
+        ypReportArrival[hdl] = 0;
+        yBlkMapSet(&ypByHwId, YP_KEY(serial, funcId), hdl);
+        ypChainAdd(&ypByFuncId, ypFuncIdNext, YP_KEY(categ, funcId), hdl);
+        ypChainAdd(&ypByName, ypNameNext, YP_KEY(categ, YSTRREF_EMPTY_STRING), hdl);
+#endif
     }
     if(funcName != INVALID_HASH_IDX)  {
         if(YP(hdl).funcName != funcName){
             changed=1;
+#ifndef MICROCHIP_API
+            ypChainRemove(&ypByName, ypNameNext, YP_KEY(categ, YP(hdl).funcName), hdl);
+            ypChainAdd(&ypByName, ypNameNext, YP_KEY(categ, funcName), hdl);
+#endif
             YP(hdl).funcName = funcName;
         }
     }
@@ -1346,7 +1963,6 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
         } else {
             funYdx = YP(hdl).funInfo.v2.funydx;
         }
-        devYdx = wpGetDevYdx(serial);
         if(devYdx >= 0) {
             cnt = funYdx;
             if(cnt == 255) { // unknown funYdx, prepare to allocate new one
@@ -1397,6 +2013,11 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
                 yahdl = YA(prev).nextPtr;
             }
             YA(yahdl).entries[cnt] = hdl;
+#ifndef MICROCHIP_API
+            if(funYdx < NB_FLAT_FUNYDX) {
+                ypFunByYdx[devYdx][funYdx] = hdl;
+            }
+#endif
         }
         if(funcVal != NULL) {
             for(i = 0; i < YOCTO_PUBVAL_SIZE/2; i++) {
@@ -1405,12 +2026,47 @@ int ypRegister(yStrRef categ, yStrRef serial, yStrRef funcId, yStrRef funcName,
                     YP(hdl).funcValWords[i] = funcValWords[i];
                 }
             }
+#ifndef MICROCHIP_API
+            ypValueArrival[hdl] = arrival;
+#endif
         }
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveWriteLock(&yYpMutex);
     return changed;
 }
 
+// Find the yp entry for a given devYdx/funYdx pair.
+// This function should only be called after seizing yYpMutex
+static yBlkHdl ypFindByYdx(u8 devYdx, u8 funYdx)
+{
+    yBlkHdl  hdl;
+
+    // Ignore unknown devYdx
+    if(devYdxPtr[devYdx] == INVALID_BLK_HDL) {
+        return INVALID_BLK_HDL;
+    }
+#ifndef MICROCHIP_API
+    if(funYdx < NB_FLAT_FUNYDX) {
+        return ypFunByYdx[devYdx][funYdx];
+    }
+#endif
+    hdl = funYdxPtr[devYdx];
+    while(hdl != INVALID_BLK_HDL && funYdx >= 6) {
+//      YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
+        if(YA(hdl).blkId != YBLKID_YPARRAY) {
+            return INVALID_BLK_HDL; // discard invalid block silently
+        }
+        hdl = YA(hdl).nextPtr;
+        funYdx -= 6;
+    }
+    // Ignore unknown funYdx
+    if(hdl == INVALID_BLK_HDL) {
+        return INVALID_BLK_HDL;
+    }
+    YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
+    return YA(hdl).entries[funYdx];
+}
+
 // return 1 on change 0 if value are the same as the cache
 // WARNING: funcVal MUST BE WORD-ALIGNED
 int ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal, YAPI_FUNCTION *fundesc)
@@ -1420,48 +2076,37 @@ int ypRegisterByYdx(u8 devYdx, Notification_funydx funInfo, const char *funcVal,
     int      funYdx = funInfo.v2.funydx;
     int      changed=0;
     const u16 *funcValWords = (const u16 *)funcVal;
+#ifndef MICROCHIP_API
+    u64      arrival = yapiGetTickCountUs();
+#endif
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterWriteLock(&yYpMutex);
 
-    // Ignore unknown devYdx
-    if(devYdxPtr[devYdx] != INVALID_BLK_HDL) {
-        hdl = funYdxPtr[devYdx];
-        while(hdl != INVALID_BLK_HDL && funYdx >= 6) {
-//          YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
-            if(YA(hdl).blkId != YBLKID_YPARRAY) {
-                yLeaveCriticalSection(&yYpMutex);
-                return 0; // discard invalid block silently
-            }
-            hdl = YA(hdl).nextPtr;
-            funYdx -= 6;
-        }
-        // Ignore unknown funYdx
-        if(hdl != INVALID_BLK_HDL) {
-            YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
-            hdl = YA(hdl).entries[funYdx];
-            if(hdl != INVALID_BLK_HDL) {
-                YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
-                if(funcVal) {
-                    // apply value change
-                    for(i = 0; i < YOCTO_PUBVAL_SIZE/2; i++) {
-                        if(YP(hdl).funcValWords[i] != funcValWords[i]) {
-                            YP(hdl).funcValWords[i] = funcValWords[i];
-                            changed = 1;
-                        }
-                    }
-                    if(YP(hdl).funInfo.raw != funInfo.raw) {
-                        YP(hdl).funInfo.raw = funInfo.raw;
-                        changed = 1;
-                    }
-                }
-                if(fundesc) {
-                    *fundesc = YP(hdl).hwId;
+    hdl = ypFindByYdx(devYdx, (u8)funYdx);
+    if(hdl != INVALID_BLK_HDL) {
+        YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
+        if(funcVal) {
+            // apply value change
+            for(i = 0; i < YOCTO_PUBVAL_SIZE/2; i++) {
+                if(YP(hdl).funcValWords[i] != funcValWords[i]) {
+                    YP(hdl).funcValWords[i] = funcValWords[i];
+                    changed = 1;
                 }
             }
+            if(YP(hdl).funInfo.raw != funInfo.raw) {
+                YP(hdl).funInfo.raw = funInfo.raw;
+                changed = 1;
+            }
+#ifndef MICROCHIP_API
+            ypValueArrival[hdl] = arrival;
+#endif
+        }
+        if(fundesc) {
+            *fundesc = YP(hdl).hwId;
         }
     }
 
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveWriteLock(&yYpMutex);
 
     return changed;
 }
@@ -1475,7 +2120,7 @@ int     ypGetAttributesByYdx(u8 devYdx, u8 funYdx, yStrRef *serial, yStrRef *log
     int      res = -1;
     u16      *funcValWords = (u16 *)funcVal;
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
 
     // Ignore unknown devYdx
     if (devYdxPtr[devYdx] != INVALID_BLK_HDL) {
@@ -1483,45 +2128,31 @@ int     ypGetAttributesByYdx(u8 devYdx, u8 funYdx, yStrRef *serial, yStrRef *log
             hdl = devYdxPtr[devYdx];
             *logicalName = WP(hdl).name;
         }
-        hdl = funYdxPtr[devYdx];
-        while (hdl != INVALID_BLK_HDL && funYdx >= 6) {
-            //          YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
-            if (YA(hdl).blkId != YBLKID_YPARRAY) {
-                yLeaveCriticalSection(&yYpMutex);
-                return -1; // discard invalid block silently
-            }
-            hdl = YA(hdl).nextPtr;
-            funYdx -= 6;
-        }
-        // Ignore unknown funYdx
+        hdl = ypFindByYdx(devYdx, funYdx);
         if (hdl != INVALID_BLK_HDL) {
-            YASSERT(YA(hdl).blkId == YBLKID_YPARRAY);
-            hdl = YA(hdl).entries[funYdx];
-            if (hdl != INVALID_BLK_HDL) {
-                YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
-                if (serial) {
-                    *serial = YP(hdl).serialNum;
-                }
-                if (funcId) {
-                    *funcId = YP(hdl).funcId;
-                }
-                if (funcName) {
-                    *funcName = YP(hdl).funcName;
-                }
-                if (funcInfo) {
-                    funcInfo->raw = YP(hdl).funInfo.raw;
-                }
-                if (funcVal) {
-                    // apply value change
-                    for (i = 0; i < YOCTO_PUBVAL_SIZE / 2; i++) {
-                        funcValWords[i] = YP(hdl).funcValWords[i];
-                    }
+            YASSERT(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND);
+            if (serial) {
+                *serial = YP(hdl).serialNum;
+            }
+            if (funcId) {
+                *funcId = YP(hdl).funcId;
+            }
+            if (funcName) {
+                *funcName = YP(hdl).funcName;
+            }
+            if (funcInfo) {
+                funcInfo->raw = YP(hdl).funInfo.raw;
+            }
+            if (funcVal) {
+                // apply value change
+                for (i = 0; i < YOCTO_PUBVAL_SIZE / 2; i++) {
+                    funcValWords[i] = YP(hdl).funcValWords[i];
                 }
-                res = 0;
             }
+            res = 0;
         }
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
     return res;
 }
 
@@ -1542,7 +2173,7 @@ int ypGetAttributes(yBlkHdl hdl, yStrRef *serial, yStrRef *funcId, yStrRef *func
     int     res = -1;
     u16     *funcValWords = (u16 *)funcVal;
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     if(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND) {
         serialref = YP(hdl).serialNum;
         funcidref = YP(hdl).funcId;
@@ -1560,7 +2191,7 @@ int ypGetAttributes(yBlkHdl hdl, yStrRef *serial, yStrRef *funcId, yStrRef *func
             funcInfo->raw = 0;
         if (funcVal) *funcVal = 0;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     if(serial != NULL)   *serial = serialref;
     if(funcId != NULL)   *funcId = funcidref;
@@ -1573,11 +2204,11 @@ int ypGetType(yBlkHdl hdl)
 {
     int res = -1;
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     if(YP(hdl).blkId >= YBLKID_YPENTRY && YP(hdl).blkId <= YBLKID_YPENTRYEND) {
         res =YP(hdl).blkId - YBLKID_YPENTRY;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     return res;
 }
@@ -1587,7 +2218,7 @@ static void ypUnregister(yStrRef serial)
     yBlkHdl  prev, next;
     yBlkHdl  cat_hdl, hdl;
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterWriteLock(&yYpMutex);
 
     // scan all category nodes
     cat_hdl = yYpListHead;
@@ -1606,6 +2237,12 @@ static void ypUnregister(yStrRef serial)
                 } else {
                     YP(prev).nextPtr = next;
                 }
+#ifndef MICROCHIP_API
+                yBlkMapSet(&ypByHwId, (u32)YP(hdl).hwId, INVALID_BLK_HDL);
+                ypChainRemove(&ypByFuncId, ypFuncIdNext, YP_KEY(YC(cat_hdl).name, YP(hdl).funcId), hdl);
+                ypChainRemove(&ypByName, ypNameNext, YP_KEY(YC(cat_hdl).name, YP(hdl).funcName), hdl);
+                ypEntryCat[hdl] = INVALID_BLK_HDL;
+#endif
                 yBlkFree(hdl);
                 // continue search on next entries
             } else {
@@ -1616,7 +2253,7 @@ static void ypUnregister(yStrRef serial)
         cat_hdl = YC(cat_hdl).nextPtr;
     }
 
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveWriteLock(&yYpMutex);
 }
 
 #ifndef MICROCHIP_API
@@ -1630,7 +2267,6 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
     const char  *dotpos = func_or_name;
     char        categname[HASH_BUF_SIZE];
     YAPI_FUNCTION  res = -1;
-    YAPI_FUNCTION  best_name = -1;
     int         i;
 
     // first search for the category node
@@ -1643,14 +2279,9 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
         categref = yHashTestStr(class_str);
         if(categref == INVALID_HASH_IDX)
             return -2; // no device of this type so far
-        yEnterCriticalSection(&yYpMutex);
-        cat_hdl = yYpListHead;
-        while(cat_hdl != INVALID_BLK_HDL) {
-            YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
-            if(YC(cat_hdl).name == categref) break;
-            cat_hdl = YC(cat_hdl).nextPtr;
-        }
-        yLeaveCriticalSection(&yYpMutex);
+        yEnterReadLock(&yYpMutex);
+        cat_hdl = ypFindCategory(categref);
+        yLeaveReadLock(&yYpMutex);
         if(cat_hdl == INVALID_BLK_HDL)
             return -2; // no device of this type so far
     }
@@ -1662,35 +2293,27 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
         funcref = yHashTestStr(func_or_name);
         if(funcref == INVALID_HASH_IDX)
             return -1;
-        yEnterCriticalSection(&yYpMutex);
+        yEnterReadLock(&yYpMutex);
         if(categref != INVALID_HASH_IDX) {
             // search within defined function category
-            hdl = YC(cat_hdl).entries;
-            while(hdl != INVALID_BLK_HDL) {
-                if(YP(hdl).funcName == funcref) {
-                    res = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                    break;
-                }
-                hdl = YP(hdl).nextPtr;
-            }
+            hdl = yBlkMapGet(&ypByName, YP_KEY(categref, funcref));
         } else {
             // search by pure logical name within abstract basetype
             hdl = INVALID_BLK_HDL;
             for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
                 YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
-                hdl = YC(cat_hdl).entries;
-                while (hdl != INVALID_BLK_HDL) {
-                    // check functions matching abstract baseclass, skip others
-                    if ((abstract == YOCTO_AKA_YFUNCTION || YP(hdl).blkId == YBLKID_YPENTRY + abstract) && YP(hdl).funcName == funcref) {
-                        res = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                        break;
-                    }
-                    hdl = YP(hdl).nextPtr;
+                hdl = yBlkMapGet(&ypByName, YP_KEY(YC(cat_hdl).name, funcref));
+                // check functions matching abstract baseclass, skip others
+                while(hdl != INVALID_BLK_HDL && !YP_IS_ABSTRACT(hdl, abstract)) {
+                    hdl = ypNameNext[hdl];
                 }
                 if(hdl != INVALID_BLK_HDL) break;
             }
         }
-        yLeaveCriticalSection(&yYpMutex);
+        if(hdl != INVALID_BLK_HDL) {
+            res = YP(hdl).hwId;
+        }
+        yLeaveReadLock(&yYpMutex);
         if(hdl != INVALID_BLK_HDL) return res;
         // not found, fallback to assuming that str_func is a logical name or serial number
         // of a module with an implicit function name (like serial.module for instance)
@@ -1717,16 +2340,10 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
 
     if(devref!= INVALID_HASH_IDX){
         // locate function identified by devref.funcref by first resolving devref
-        byname = INVALID_BLK_HDL;
-        yEnterCriticalSection(&yWpMutex);
-        hdl = yWpListHead;
-        while(hdl != INVALID_BLK_HDL) {
-            YASSERT(WP(hdl).blkId == YBLKID_WPENTRY);
-            if(WP(hdl).serial == devref) break;
-            if(WP(hdl).name == devref) byname = hdl;
-            hdl = WP(hdl).nextPtr;
-        }
-        yLeaveCriticalSection(&yWpMutex);
+        yEnterReadLock(&yWpMutex);
+        hdl = wpFindBySerial(devref);
+        byname = (hdl == INVALID_BLK_HDL ? wpFindByName(devref, 1) : INVALID_BLK_HDL);
+        yLeaveReadLock(&yWpMutex);
         if(hdl == INVALID_BLK_HDL) {
             if(byname == INVALID_BLK_HDL)
                 return -1;
@@ -1735,61 +2352,75 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_or_name)
         }
     }
     // device found, now we can search for function by serial.funcref
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     if(categref != INVALID_HASH_IDX) {
         // search within defined function category
-        hdl = YC(cat_hdl).entries;
-        while(hdl != INVALID_BLK_HDL) {
-            if(devref==INVALID_HASH_IDX || YP(hdl).serialNum == devref) {
-                if(YP(hdl).funcId == funcref) {
-                    res = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                    break;
-                }
-                if (best_name == -1 && YP(hdl).funcName == funcref) {
-                    best_name = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                }
+        if(devref != INVALID_HASH_IDX) {
+            hdl = yBlkMapGet(&ypByHwId, YP_KEY(devref, funcref));
+            if(hdl != INVALID_BLK_HDL && ypEntryCat[hdl] != cat_hdl) {
+                hdl = INVALID_BLK_HDL;
+            }
+        } else {
+            hdl = yBlkMapGet(&ypByFuncId, YP_KEY(categref, funcref));
+        }
+        if(hdl == INVALID_BLK_HDL) {
+            // no such funcId, fallback to a function with this logical name
+            hdl = yBlkMapGet(&ypByName, YP_KEY(categref, funcref));
+            while(hdl != INVALID_BLK_HDL && devref != INVALID_HASH_IDX && YP(hdl).serialNum != devref) {
+                hdl = ypNameNext[hdl];
             }
-            hdl = YP(hdl).nextPtr;
         }
     } else {
-        // search by pure logical name within abstract basetype
-        for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
-            YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
-            hdl = YC(cat_hdl).entries;
-            while(hdl != INVALID_BLK_HDL) {
+        // search by funcId within abstract basetype
+        if(devref != INVALID_HASH_IDX) {
+            hdl = yBlkMapGet(&ypByHwId, YP_KEY(devref, funcref));
+            if(hdl != INVALID_BLK_HDL && !YP_IS_ABSTRACT(hdl, abstract)) {
+                hdl = INVALID_BLK_HDL;
+            }
+        } else {
+            hdl = INVALID_BLK_HDL;
+            for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
+                YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
+                hdl = yBlkMapGet(&ypByFuncId, YP_KEY(YC(cat_hdl).name, funcref));
                 // check functions matching abstract baseclass, skip others
-                if ((abstract == YOCTO_AKA_YFUNCTION || YP(hdl).blkId == YBLKID_YPENTRY + abstract) && (devref == INVALID_HASH_IDX || YP(hdl).serialNum == devref)) {
-                    if (YP(hdl).funcId == funcref) {
-                        res = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                        break;
-                    }
-                    if (best_name != -1 && YP(hdl).funcName == funcref) {
-                        best_name = YP(hdl).serialNum + ((u32)(YP(hdl).funcId) << 16);
-                    }
+                while(hdl != INVALID_BLK_HDL && !YP_IS_ABSTRACT(hdl, abstract)) {
+                    hdl = ypFuncIdNext[hdl];
                 }
-                hdl = YP(hdl).nextPtr;
+                if(hdl != INVALID_BLK_HDL) break;
             }
-            if(hdl != INVALID_BLK_HDL) break;
         }
     }
-    if (res == -1 && best_name != -1) {
-        res = best_name;
+    if(hdl != INVALID_BLK_HDL) {
+        res = YP(hdl).hwId;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     return res;
 }
 
 
+// This function should only be called after seizing yYpMutex
+static int ypMatchFunction(yBlkHdl hdl, yBlkHdl cat_hdl, int abstract, YAPI_DEVICE devdesc)
+{
+    if(cat_hdl != INVALID_BLK_HDL) {
+        // search for a specific function type
+        if(ypEntryCat[hdl] != cat_hdl) return 0;
+    } else {
+        // search any type of function, but skip Module
+        if(YC(ypEntryCat[hdl]).name == YSTRREF_MODULE_STRING) return 0;
+    }
+    // if an abstract baseclass is specified, skip others
+    if(abstract && YP(hdl).blkId != YBLKID_YPENTRY+abstract) return 0;
+    return (devdesc == -1 || YP(hdl).serialNum == (u16)devdesc);
+}
+
 int ypGetFunctions(const char *class_str, YAPI_DEVICE devdesc, YAPI_FUNCTION prevfundesc,
                    YAPI_FUNCTION *buffer,int maxsize,int *neededsize)
 {
     yStrRef categref = INVALID_HASH_IDX;
-    yBlkHdl cat_hdl, hdl;
+    yBlkHdl cat_hdl, hdl, categ = INVALID_BLK_HDL;
     int     abstract = 0;
     int     maxfun = 0, nbreturned = 0;
-    YAPI_FUNCTION fundescr=0;
-    int     use = (prevfundesc==0);// if prefuncdesc == 0  use any functions
 
     if(class_str) {
         if (!strcmp(class_str, "Function")) {
@@ -1804,84 +2435,67 @@ int ypGetFunctions(const char *class_str, YAPI_DEVICE devdesc, YAPI_FUNCTION pre
             }
         }
     }
-    yEnterCriticalSection(&yYpMutex);
-    for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
-        YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
-        if(categref == INVALID_HASH_IDX) {
-            // search any type of function, but skip Module
-            if(YC(cat_hdl).name == YSTRREF_MODULE_STRING) continue;
+    yEnterReadLock(&yYpMutex);
+    if(categref != INVALID_HASH_IDX) {
+        categ = ypFindCategory(categref);
+        if(categ == INVALID_BLK_HDL) {
+            // known name, but no function of this class so far
+            yLeaveReadLock(&yYpMutex);
+            if(neededsize) *neededsize = 0;
+            return 0;
+        }
+        cat_hdl = categ;
+    } else {
+        cat_hdl = yYpListHead;
+    }
+    hdl = (cat_hdl != INVALID_BLK_HDL ? YC(cat_hdl).entries : INVALID_BLK_HDL);
+    if(prevfundesc != 0) {
+        // resume enumeration right after prevfundesc (if still present)
+        hdl = yBlkMapGet(&ypByHwId, (u32)prevfundesc);
+        if(hdl == INVALID_BLK_HDL || !ypMatchFunction(hdl, categ, abstract, devdesc)) {
+            cat_hdl = INVALID_BLK_HDL;
         } else {
-            // search for a specific function type
-            if(YC(cat_hdl).name != categref) continue;
+            cat_hdl = ypEntryCat[hdl];
+            hdl = YP(hdl).nextPtr;
         }
-        hdl = YC(cat_hdl).entries;
-        while(hdl != INVALID_BLK_HDL) {
-            // if an abstract baseclass is specified, skip others
-            if(abstract && YP(hdl).blkId != YBLKID_YPENTRY+abstract) {
-                hdl = YP(hdl).nextPtr;
-                continue;
-            }
-            if(devdesc == -1 || YP(hdl).serialNum == (u16)devdesc) {
-                if(!use && prevfundesc == fundescr){
-                    use = 1;
-                }
-                fundescr = YP(hdl).hwId;
-                if(use) {
+    }
+    while(cat_hdl != INVALID_BLK_HDL) {
+        YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
+        // search any type of function, but skip Module
+        if(categref != INVALID_HASH_IDX || YC(cat_hdl).name != YSTRREF_MODULE_STRING) {
+            while(hdl != INVALID_BLK_HDL) {
+                // if an abstract baseclass is specified, skip others
+                if((!abstract || YP(hdl).blkId == YBLKID_YPENTRY+abstract) &&
+                   (devdesc == -1 || YP(hdl).serialNum == (u16)devdesc)) {
                     maxfun++;
                     if(maxsize >= (int)sizeof(YAPI_FUNCTION)) {
                         maxsize -= sizeof(YAPI_FUNCTION);
                         if (buffer){
-                            *buffer++ = fundescr;
+                            *buffer++ = YP(hdl).hwId;
                             nbreturned++;
                         }
                     }
                 }
+                hdl = YP(hdl).nextPtr;
             }
-            hdl = YP(hdl).nextPtr;
         }
         // if we were looking for a specific category, we found it
         if(categref != INVALID_HASH_IDX) break;
+        cat_hdl = YC(cat_hdl).nextPtr;
+        if(cat_hdl != INVALID_BLK_HDL) hdl = YC(cat_hdl).entries;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     if(neededsize) *neededsize = sizeof(YAPI_FUNCTION) * maxfun;
     return nbreturned;
 }
 
 
-// This function should only be called after seizing ypMutex
+// This function should only be called after seizing yYpMutex
 static yBlkHdl functionSearch(YAPI_FUNCTION fundesc)
 {
-    yBlkHdl cat_hdl, hdl;
-    yStrRef funcref, categref;
-    char    funcname[YOCTO_FUNCTION_LEN], *p;
-
-    funcref = (u16)(fundesc >> 16);
-    yHashGetStr(funcref, funcname, YOCTO_FUNCTION_LEN);
-    funcname[0] &= ~0x20; // uppercase first letter
-    for(p = funcname+1; *p > '9'; p++);
-    *p = 0;
-    categref = yHashTestStr(funcname);
-    if(categref == INVALID_HASH_IDX)
-        return INVALID_BLK_HDL; // no device of this type so far, should never happen
-
-    cat_hdl = yYpListHead;
-    while(cat_hdl != INVALID_BLK_HDL) {
-        YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
-        if(YC(cat_hdl).name == categref) break;
-        cat_hdl = YC(cat_hdl).nextPtr;
-    }
-    if(cat_hdl == INVALID_BLK_HDL)
-        return INVALID_BLK_HDL; // no device of this type so far, should never happen
-
-    hdl = YC(cat_hdl).entries;
-    while(hdl != INVALID_BLK_HDL) {
-        if(YP(hdl).hwId == fundesc) {
-            return hdl;
-        }
-        hdl = YP(hdl).nextPtr;
-    }
-    return INVALID_BLK_HDL; // device not found, most probably unplugged
+    // returns INVALID_BLK_HDL if the device is unknown, most probably unplugged
+    return yBlkMapGet(&ypByHwId, (u32)fundesc);
 }
 
 int ypGetFunctionInfo(YAPI_FUNCTION fundesc, char *serial, char *funcId, char *baseType, char *funcName, char *funcVal)
@@ -1890,7 +2504,7 @@ int ypGetFunctionInfo(YAPI_FUNCTION fundesc, char *serial, char *funcId, char *b
     u16     i;
     u16     *funcValWords = (u16 *)funcVal;
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     hdl = functionSearch(fundesc);
     if(hdl != INVALID_BLK_HDL) {
         if(serial)   yHashGetStr(YP(hdl).serialNum, serial, YOCTO_SERIAL_LEN);
@@ -1916,11 +2530,94 @@ int ypGetFunctionInfo(YAPI_FUNCTION fundesc, char *serial, char *funcId, char *b
     } else {
         if(funcVal != NULL) funcVal[0] = 0;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     return (hdl == INVALID_BLK_HDL ? -1 : 0);
 }
 
+void ypSetTimedReportTime(YAPI_FUNCTION fundesc, double deviceTime)
+{
+    yBlkHdl hdl;
+    u64     arrival = yapiGetTickCountUs();
+    u64     timebits;
+
+    memcpy(&timebits, &deviceTime, sizeof(timebits));
+    // called for every timed report: the read lock is enough to keep the
+    // entry alive, and does not block the other readers
+    yEnterReadLock(&yYpMutex);
+    hdl = functionSearch(fundesc);
+    if(hdl != INVALID_BLK_HDL) {
+        yAtomicStore64(&ypLastTimedReport[hdl], timebits);
+        yAtomicStore64(&ypReportArrival[hdl], arrival);
+    }
+    yLeaveReadLock(&yYpMutex);
+}
+
+// Fill buffer with a consistent copy of all functions of a class (or of all
+// functions but Module if class_str is NULL), taken under a single lock
+int ypGetFunctionsSnapshot(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize)
+{
+    yStrRef categref = INVALID_HASH_IDX;
+    yBlkHdl cat_hdl, hdl, wp_hdl;
+    int     abstract = 0;
+    int     maxfun = 0, nbreturned = 0;
+    int     type;
+    u64     timebits;
+
+    if(class_str) {
+        if (!strcmp(class_str, "Function")) {
+            abstract = YOCTO_AKA_YFUNCTION;
+        } else if (!strcmp(class_str, "Sensor")) {
+            abstract = YOCTO_AKA_YSENSOR;
+        } else {
+            categref = yHashTestStr(class_str);
+            if(categref == INVALID_HASH_IDX) {
+                if(neededsize) *neededsize = 0;
+                return 0;
+            }
+        }
+    }
+    yEnterReadLock(&yWpMutex);
+    yEnterReadLock(&yYpMutex);
+    cat_hdl = (categref != INVALID_HASH_IDX ? ypFindCategory(categref) : yYpListHead);
+    for(; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
+        YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
+        // search any type of function, but skip Module
+        if(categref != INVALID_HASH_IDX || YC(cat_hdl).name != YSTRREF_MODULE_STRING) {
+            for(hdl = YC(cat_hdl).entries; hdl != INVALID_BLK_HDL; hdl = YP(hdl).nextPtr) {
+                type = YP(hdl).blkId - YBLKID_YPENTRY;
+                // if an abstract baseclass is specified, skip others
+                if(abstract && type != abstract) continue;
+                maxfun++;
+                if(buffer == NULL || maxsize < (int)sizeof(yFunctionSnapshotSt)) continue;
+                maxsize -= sizeof(yFunctionSnapshotSt);
+                buffer->fundesc = YP(hdl).hwId;
+                wp_hdl = wpBySerial[YP(hdl).serialNum];
+                buffer->devYdx = (wp_hdl != INVALID_BLK_HDL ? WP(wp_hdl).devYdx : -1);
+                buffer->baseType = (type == YOCTO_AKA_YSENSOR ? YOCTO_AKA_YSENSOR : YOCTO_AKA_YFUNCTION);
+                yHashGetStr(YC(cat_hdl).name, buffer->className, YOCTO_FUNCTION_LEN);
+                yHashGetStr(YP(hdl).funcId, buffer->funcId, YOCTO_FUNCTION_LEN);
+                yHashGetStr(YP(hdl).funcName, buffer->funcName, YOCTO_LOGICAL_LEN);
+                memcpy(buffer->funcVal, YP(hdl).funcVal, YOCTO_PUBVAL_SIZE);
+                buffer->funcVal[YOCTO_PUBVAL_SIZE] = 0;
+                timebits = yAtomicLoad64(&ypLastTimedReport[hdl]);
+                memcpy(&buffer->lastTimedReport, &timebits, sizeof(buffer->lastTimedReport));
+                buffer->valueArrival = ypValueArrival[hdl];
+                buffer->reportArrival = yAtomicLoad64(&ypReportArrival[hdl]);
+                buffer++;
+                nbreturned++;
+            }
+        }
+        // if we were looking for a specific category, we found it
+        if(categref != INVALID_HASH_IDX) break;
+    }
+    yLeaveReadLock(&yYpMutex);
+    yLeaveReadLock(&yWpMutex);
+
+    if(neededsize) *neededsize = sizeof(yFunctionSnapshotSt) * maxfun;
+    return nbreturned;
+}
+
 #endif
 
 
@@ -1936,7 +2633,7 @@ int ypGetFunctionsEx(yStrRef categref, YAPI_DEVICE devdesc, YAPI_FUNCTION prevfu
     if (categref == YSTRREF_SENSOR_STRING) {
         abstract = YOCTO_AKA_YSENSOR;
     }
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     for (cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
         YASSERT(YC(cat_hdl).blkId == YBLKID_YPCATEG);
         if (categref == INVALID_HASH_IDX) {
@@ -1974,7 +2671,7 @@ int ypGetFunctionsEx(yStrRef categref, YAPI_DEVICE devdesc, YAPI_FUNCTION prevfu
         // if we were looking for a specific category, we found it
         if (categref != INVALID_HASH_IDX) break;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     if (neededsize) *neededsize = sizeof(YAPI_FUNCTION) * maxfun;
     return nbreturned;
@@ -1988,17 +2685,13 @@ s16 ypFindBootloaders(yStrRef *serials, u16 maxSerials)
     s16         res = 0;
 
     // first search for the category node
-    yEnterCriticalSection(&yYpMutex);
-    cat_hdl = yYpListHead;
-    while(cat_hdl != INVALID_BLK_HDL) {
-        if(YC(cat_hdl).name == YSTRREF_HUBPORT_STRING) break;
-        cat_hdl = YC(cat_hdl).nextPtr;
-    }
-    yLeaveCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
+    cat_hdl = ypFindCategory(YSTRREF_HUBPORT_STRING);
+    yLeaveReadLock(&yYpMutex);
     if(cat_hdl == INVALID_BLK_HDL)
         return -2; // no hubPort registered so far
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     hdl = YC(cat_hdl).entries;
     while(hdl != INVALID_BLK_HDL) {
         if(YP(hdl).funcValWords[0]==WORD_TEXT_PR && YP(hdl).funcValWords[1]==WORD_TEXT_OG) {
@@ -2008,7 +2701,7 @@ s16 ypFindBootloaders(yStrRef *serials, u16 maxSerials)
         }
         hdl = YP(hdl).nextPtr;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
 
     return res;
 }
@@ -2026,17 +2719,17 @@ int ypGetBootDevHdl(const char *serial)
         return -1; // unknown serial
 
     // search for the category node
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     cat_hdl = yYpListHead;
     while(cat_hdl != INVALID_BLK_HDL) {
         if(YC(cat_hdl).name == YSTRREF_HUBPORT_STRING) break;
         cat_hdl = YC(cat_hdl).nextPtr;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
     if(cat_hdl == INVALID_BLK_HDL)
         return -2; // no hubPort registered so far
 
-    yEnterCriticalSection(&yYpMutex);
+    yEnterReadLock(&yYpMutex);
     hdl = YC(cat_hdl).entries;
     while(hdl != INVALID_BLK_HDL) {
         if(YP(hdl).funcName == serialRef &&
@@ -2046,7 +2739,7 @@ int ypGetBootDevHdl(const char *serial)
         }
         hdl = YP(hdl).nextPtr;
     }
-    yLeaveCriticalSection(&yYpMutex);
+    yLeaveReadLock(&yYpMutex);
     if(hdl == INVALID_BLK_HDL)
         return -3; // serial not connected in PROG mode
 
@@ -2104,3 +2797,345 @@ int decodeNetFuncValV2(const u8 *p, Notification_funydx *funInfo, char *funcVal)
     return len;
 }
 
+
+#ifndef MICROCHIP_API
+// =======================================================================
+//   Warm-start cache
+// =======================================================================
+//
+// The cache is a flat little blob that can be written to disk and read
+// back (or memory-mapped) on next start. It is made of fixed-size records
+// that refer to strings by index, so that it does not depend on yStrRef
+// values of the process that wrote it:
+//
+//   yCacheHeader | wp records | yp records | hub records | u32 string
+//   offsets | null-terminated strings
+//
+// Urls are stored as a yAbsUrl in which the words that are string
+// references are replaced by string indexes (see urlStrMask).
+
+#define YCACHE_MAGIC        0x43505759  /* 'YWPC' */
+#define YCACHE_VERSION      1
+#define YCACHE_NOSTR        0xffff
+#define YCACHE_URL_WORDS    (sizeof(yAbsUrl)/sizeof(u16))
+
+typedef struct {
+    u32     magic;
+    u16     version;
+    u16     urlWords;
+    u32     nbStr;
+    u32     nbWp;
+    u32     nbYp;
+    u32     nbHub;
+    u32     size;
+} yCacheHeader;
+
+typedef struct {
+    u16     serial;
+    u16     name;
+    u16     product;
+    u16     devid;
+    u16     url[YCACHE_URL_WORDS];
+    u16     urlStrMask;
+    u16     beacon;
+} yCacheWpRec;
+
+typedef struct {
+    u16     categ;
+    u16     serial;
+    u16     funcId;
+    u16     funcName;
+    u8      funClass;
+    u8      funYdx;
+    char    funcVal[YOCTO_PUBVAL_SIZE];
+} yCacheYpRec;
+
+typedef struct {
+    u16     url[YCACHE_URL_WORDS];
+    u16     urlStrMask;
+    u16     pad;
+    u16     serials[ALLOC_YDX_PER_HUB];     // serial index for each hub devYdx
+} yCacheHubRec;
+
+typedef struct {
+    u16     *idx;       // yStrRef -> string index
+    yStrRef *refs;      // string index -> yStrRef
+    u32     nbStr;
+    u32     strSize;
+} yCacheStrTab;
+
+static u16 yCacheStrLen(yStrRef ref)
+{
+    u16 len;
+    for(len = 0; len < HASH_BUF_SIZE && yHashTable[ref].buff[len]; len++);
+    return len;
+}
+
+static u16 yCacheAddStr(yCacheStrTab *tab, yStrRef ref)
+{
+    if(ref < 0 || ref >= NB_MAX_HASH_ENTRIES) return YCACHE_NOSTR;
+    if(tab->idx[ref] == YCACHE_NOSTR) {
+        tab->idx[ref] = (u16)tab->nbStr;
+        tab->refs[tab->nbStr++] = ref;
+        tab->strSize += yCacheStrLen(ref) + 1;
+    }
+    return tab->idx[ref];
+}
+
+// Return a bitmask of the yAbsUrl words that hold a string reference
+static u16 yCacheUrlStrMask(const yAbsUrl *absurl)
+{
+    const u16 *words = (const u16 *)absurl;
+    u16 mask, i;
+
+    if(absurl->byusb.invalid1 == INVALID_HASH_IDX && absurl->byusb.invalid2 == INVALID_HASH_IDX) {
+        mask = 1 << 2;              // serial
+    } else if(absurl->byip.invalid == INVALID_HASH_IDX) {
+        mask = 1 << 0;              // ip
+    } else {
+        mask = (1 << 0) | (1 << 1); // host, domain
+    }
+    // word 3 is the protocol, all following words are strings
+    for(i = 4; i < YCACHE_URL_WORDS; i++) {
+        mask |= 1 << i;
+    }
+    for(i = 0; i < YCACHE_URL_WORDS; i++) {
+        if(words[i] == (u16)INVALID_HASH_IDX) mask &= ~(1 << i);
+    }
+    return mask;
+}
+
+static u16 yCacheAddUrl(yCacheStrTab *tab, yUrlRef urlref, u16 *dest)
+{
+    yAbsUrl absurl;
+    const u16 *words = (const u16 *)&absurl;
+    u16     mask, i;
+
+    yHashGetBuf(urlref, (u8 *)&absurl, sizeof(absurl));
+    mask = yCacheUrlStrMask(&absurl);
+    for(i = 0; i < YCACHE_URL_WORDS; i++) {
+        dest[i] = (mask & (1 << i) ? yCacheAddStr(tab, (yStrRef)words[i]) : words[i]);
+    }
+    return mask;
+}
+
+// Serialize white pages, yellow pages and the devYdx map of the given hubs
+// into a newly allocated buffer, to be freed by the caller
+int yHashSaveCache(const yUrlRef *hubUrls, u8 * const *hubMaps, int nbHubs, u8 **buffer, u32 *size)
+{
+    yCacheStrTab    tab;
+    yCacheHeader    *hdr;
+    yCacheWpRec     *wprec;
+    yCacheYpRec     *yprec;
+    yCacheHubRec    *hubrec;
+    u32             *strofs;
+    char            *strdata;
+    yBlkHdl         hdl, cat_hdl;
+    u32             nbWp = 0, nbYp = 0, total, i;
+    int             h, j;
+
+    tab.idx = (u16 *)yMalloc(NB_MAX_HASH_ENTRIES * sizeof(u16));
+    tab.refs = (yStrRef *)yMalloc(NB_MAX_HASH_ENTRIES * sizeof(yStrRef));
+    memset(tab.idx, 0xff, NB_MAX_HASH_ENTRIES * sizeof(u16));
+    tab.nbStr = 0;
+    tab.strSize = 0;
+
+    yEnterReadLock(&yWpMutex);
+    yEnterReadLock(&yYpMutex);
+    nbWp = yBlkListLength(yWpListHead);
+    for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
+        nbYp += yBlkListLength(YC(cat_hdl).entries);
+    }
+    wprec = (yCacheWpRec *)yMalloc((nbWp + 1) * sizeof(yCacheWpRec));
+    yprec = (yCacheYpRec *)yMalloc((nbYp + 1) * sizeof(yCacheYpRec));
+    hubrec = (yCacheHubRec *)yMalloc((nbHubs + 1) * sizeof(yCacheHubRec));
+    for(i = 0, hdl = yWpListHead; hdl != INVALID_BLK_HDL; hdl = WP(hdl).nextPtr) {
+        if(WP(hdl).flags & YWP_MARK_FOR_UNREGISTER) continue;
+        wprec[i].serial  = yCacheAddStr(&tab, WP(hdl).serial);
+        wprec[i].name    = yCacheAddStr(&tab, WP(hdl).name);
+        wprec[i].product = yCacheAddStr(&tab, WP(hdl).product);
+        wprec[i].devid   = WP(hdl).devid;
+        wprec[i].urlStrMask = yCacheAddUrl(&tab, WP(hdl).url, wprec[i].url);
+        wprec[i].beacon  = (WP(hdl).flags & YWP_BEACON_ON ? 1 : 0);
+        i++;
+    }
+    nbWp = i;
+    i = 0;
+    for(cat_hdl = yYpListHead; cat_hdl != INVALID_BLK_HDL; cat_hdl = YC(cat_hdl).nextPtr) {
+        for(hdl = YC(cat_hdl).entries; hdl != INVALID_BLK_HDL; hdl = YP(hdl).nextPtr) {
+            yprec[i].categ    = yCacheAddStr(&tab, YC(cat_hdl).name);
+            yprec[i].serial   = yCacheAddStr(&tab, YP(hdl).serialNum);
+            yprec[i].funcId   = yCacheAddStr(&tab, YP(hdl).funcId);
+            yprec[i].funcName = yCacheAddStr(&tab, YP(hdl).funcName);
+            yprec[i].funClass = YP(hdl).blkId - YBLKID_YPENTRY;
+            yprec[i].funYdx   = (YP(hdl).funInfo.raw == 0xff ? 0xff : YP(hdl).funInfo.v2.funydx);
+            memcpy(yprec[i].funcVal, YP(hdl).funcVal, YOCTO_PUBVAL_SIZE);
+            i++;
+        }
+    }
+    nbYp = i;
+    for(h = 0; h < nbHubs; h++) {
+        hubrec[h].urlStrMask = yCacheAddUrl(&tab, hubUrls[h], hubrec[h].url);
+        hubrec[h].pad = 0;
+        for(j = 0; j < ALLOC_YDX_PER_HUB; j++) {
+            int devYdx = hubMaps[h][j];
+            hdl = (devYdx < NB_MAX_DEVICES ? devYdxPtr[devYdx] : INVALID_BLK_HDL);
+            hubrec[h].serials[j] = (hdl != INVALID_BLK_HDL ? yCacheAddStr(&tab, WP(hdl).serial) : YCACHE_NOSTR);
+        }
+    }
+    yLeaveReadLock(&yYpMutex);
+    yLeaveReadLock(&yWpMutex);
+
+    total = sizeof(yCacheHeader) + nbWp * sizeof(yCacheWpRec) + nbYp * sizeof(yCacheYpRec) +
+            nbHubs * sizeof(yCacheHubRec) + tab.nbStr * sizeof(u32) + tab.strSize;
+    hdr = (yCacheHeader *)yMalloc(total);
+    hdr->magic    = YCACHE_MAGIC;
+    hdr->version  = YCACHE_VERSION;
+    hdr->urlWords = YCACHE_URL_WORDS;
+    hdr->nbStr    = tab.nbStr;
+    hdr->nbWp     = nbWp;
+    hdr->nbYp     = nbYp;
+    hdr->nbHub    = nbHubs;
+    hdr->size     = total;
+    memcpy(hdr + 1, wprec, nbWp * sizeof(yCacheWpRec));
+    memcpy((u8 *)(hdr + 1) + nbWp * sizeof(yCacheWpRec), yprec, nbYp * sizeof(yCacheYpRec));
+    memcpy((u8 *)(hdr + 1) + nbWp * sizeof(yCacheWpRec) + nbYp * sizeof(yCacheYpRec), hubrec, nbHubs * sizeof(yCacheHubRec));
+    strofs = (u32 *)((u8 *)hdr + total - tab.strSize - tab.nbStr * sizeof(u32));
+    strdata = (char *)hdr + total - tab.strSize;
+    for(i = 0; i < tab.nbStr; i++) {
+        u16 len = yCacheStrLen(tab.refs[i]);
+        strofs[i] = (u32)(strdata - (char *)hdr);
+        memcpy(strdata, yHashTable[tab.refs[i]].buff, len);
+        strdata[len] = 0;
+        strdata += len + 1;
+    }
+    yFree(wprec);
+    yFree(yprec);
+    yFree(hubrec);
+    yFree(tab.idx);
+    yFree(tab.refs);
+    *buffer = (u8 *)hdr;
+    *size = total;
+    return 0;
+}
+
+// Check the cache header and return the table of string offsets, or NULL
+static const u32 *yCacheCheck(const u8 *buffer, u32 size)
+{
+    const yCacheHeader *hdr = (const yCacheHeader *)buffer;
+    u32 recsize, i;
+    const u32 *strofs;
+
+    if(size < sizeof(yCacheHeader) || hdr->magic != YCACHE_MAGIC || hdr->version != YCACHE_VERSION ||
+       hdr->urlWords != YCACHE_URL_WORDS || hdr->size != size || hdr->nbStr > NB_MAX_HASH_ENTRIES ||
+       hdr->nbWp > NB_MAX_DEVICES || hdr->nbYp > NB_MAX_BLK_HDL || hdr->nbHub > 256) {
+        return NULL;
+    }
+    recsize = sizeof(yCacheHeader) + hdr->nbWp * sizeof(yCacheWpRec) + hdr->nbYp * sizeof(yCacheYpRec) +
+              hdr->nbHub * sizeof(yCacheHubRec) + hdr->nbStr * sizeof(u32);
+    if(recsize > size) return NULL;
+    strofs = (const u32 *)(buffer + recsize - hdr->nbStr * sizeof(u32));
+    for(i = 0; i < hdr->nbStr; i++) {
+        if(strofs[i] < recsize || strofs[i] >= size) return NULL;
+    }
+    // the last string must be terminated within the buffer
+    if(size > recsize && buffer[size-1] != 0) return NULL;
+    return strofs;
+}
+
+static yStrRef yCacheGetStr(const u8 *buffer, const u32 *strofs, u32 nbStr, u16 idx)
+{
+    if(idx >= nbStr) return INVALID_HASH_IDX;
+    return yHashPutStr((const char *)buffer + strofs[idx]);
+}
+
+static yUrlRef yCacheGetUrl(const u8 *buffer, const u32 *strofs, u32 nbStr, const u16 *words, u16 mask)
+{
+    yAbsUrl absurl;
+    u16     *dest = (u16 *)&absurl;
+    u16     i;
+
+    for(i = 0; i < YCACHE_URL_WORDS; i++) {
+        if(mask & (1 << i)) {
+            dest[i] = (u16)yCacheGetStr(buffer, strofs, nbStr, words[i]);
+            if(dest[i] == (u16)INVALID_HASH_IDX) return INVALID_HASH_IDX;
+        } else {
+            dest[i] = words[i];
+        }
+    }
+    return yHashPutBuf((const u8 *)&absurl, sizeof(absurl));
+}
+
+// Restore white and yellow pages from a cache buffer. Restored devices are
+// flagged YWP_FROM_CACHE until they are registered again for real.
+// Returns the number of devices restored, or -1 if the cache is invalid.
+int yHashLoadCache(const u8 *buffer, u32 size)
+{
+    const yCacheHeader *hdr = (const yCacheHeader *)buffer;
+    const yCacheWpRec  *wprec;
+    const yCacheYpRec  *yprec;
+    const u32          *strofs;
+    u32                i;
+    int                count = 0;
+
+    strofs = yCacheCheck(buffer, size);
+    if(strofs == NULL) return -1;
+    wprec = (const yCacheWpRec *)(hdr + 1);
+    yprec = (const yCacheYpRec *)(wprec + hdr->nbWp);
+    for(i = 0; i < hdr->nbWp; i++, wprec++) {
+        yStrRef serial = yCacheGetStr(buffer, strofs, hdr->nbStr, wprec->serial);
+        yUrlRef url = yCacheGetUrl(buffer, strofs, hdr->nbStr, wprec->url, wprec->urlStrMask);
+        if(serial == INVALID_HASH_IDX || url == INVALID_HASH_IDX) continue;
+        // never override a device that is already known
+        if(wpGetDevYdx(serial) >= 0) continue;
+        if(wpEntryCount() >= NB_MAX_DEVICES - 1) break;
+        wpRegister(-1, serial,
+                   yCacheGetStr(buffer, strofs, hdr->nbStr, wprec->name),
+                   yCacheGetStr(buffer, strofs, hdr->nbStr, wprec->product),
+                   wprec->devid, url, (s8)wprec->beacon);
+        wpSetFromCache(serial);
+        count++;
+    }
+    for(i = 0; i < hdr->nbYp; i++, yprec++) {
+        yStrRef serial = yCacheGetStr(buffer, strofs, hdr->nbStr, yprec->serial);
+        yStrRef categ = yCacheGetStr(buffer, strofs, hdr->nbStr, yprec->categ);
+        yStrRef funcId = yCacheGetStr(buffer, strofs, hdr->nbStr, yprec->funcId);
+        u16     funcVal[YOCTO_PUBVAL_SIZE/2];
+        if(serial == INVALID_HASH_IDX || categ == INVALID_HASH_IDX || funcId == INVALID_HASH_IDX) continue;
+        if(!wpIsFromCache(serial) || yprec->funClass >= YOCTO_N_BASECLASSES) continue;
+        memcpy(funcVal, yprec->funcVal, YOCTO_PUBVAL_SIZE);
+        ypRegister(categ, serial, funcId, yCacheGetStr(buffer, strofs, hdr->nbStr, yprec->funcName),
+                   yprec->funClass, (yprec->funYdx == 0xff ? -1 : yprec->funYdx), (const char *)funcVal);
+    }
+    return count;
+}
+
+// Fill a hub devYdx map from the cache, for the hub with the given url
+int yHashLoadCacheHubMap(const u8 *buffer, u32 size, yUrlRef hubUrl, u8 *devYdxMap)
+{
+    const yCacheHeader *hdr = (const yCacheHeader *)buffer;
+    const yCacheHubRec *hubrec;
+    const u32          *strofs;
+    u32                i;
+    int                j, count = 0;
+
+    strofs = yCacheCheck(buffer, size);
+    if(strofs == NULL) return -1;
+    hubrec = (const yCacheHubRec *)((const u8 *)(hdr + 1) + hdr->nbWp * sizeof(yCacheWpRec) + hdr->nbYp * sizeof(yCacheYpRec));
+    for(i = 0; i < hdr->nbHub; i++, hubrec++) {
+        yUrlRef url = yCacheGetUrl(buffer, strofs, hdr->nbStr, hubrec->url, hubrec->urlStrMask);
+        if(url == INVALID_HASH_IDX || !yHashSameHub(url, hubUrl)) continue;
+        for(j = 0; j < ALLOC_YDX_PER_HUB; j++) {
+            if(hubrec->serials[j] != YCACHE_NOSTR && devYdxMap[j] == 255) {
+                int devYdx = wpGetDevYdx(yCacheGetStr(buffer, strofs, hdr->nbStr, hubrec->serials[j]));
+                if(devYdx >= 0) {
+                    devYdxMap[j] = (u8)devYdx;
+                    count++;
+                }
+            }
+        }
+        break;
+    }
+    return count;
+}
+#endif
@@ -104,6 +104,7 @@ typedef struct {
 // WP entry flags
 #define YWP_MARK_FOR_UNREGISTER 0x02
 #define YWP_BEACON_ON           0x01
+#define YWP_FROM_CACHE          0x04    /* restored from warm-start cache, not yet seen */
 
 typedef struct {
     u8          posYdx;
@@ -253,6 +254,12 @@ YAPI_DEVICE wpSearchEx(yStrRef strref);
 YAPI_DEVICE wpSearch(const char *device_str);
 YAPI_DEVICE wpSearchByUrl(const char *host, const char *rootUrl);
 int     wpGetAllDevUsingHubUrl( yUrlRef hubUrl, yStrRef *buffer,int sizeInStrRef);
+void    wpSetFromCache(yStrRef serial);
+int     wpIsFromCache(yStrRef serial);
+int     wpGetCachedDevices(yStrRef *serials, yUrlRef *urls, int sizeInStrRef);
+int     yHashSaveCache(const yUrlRef *hubUrls, u8 * const *hubMaps, int nbHubs, u8 **buffer, u32 *size);
+int     yHashLoadCache(const u8 *buffer, u32 size);
+int     yHashLoadCacheHubMap(const u8 *buffer, u32 size, yUrlRef hubUrl, u8 *devYdxMap);
 
 yUrlRef wpGetDeviceUrlRef(YAPI_DEVICE devdesc);
 int     wpGetDeviceUrl(YAPI_DEVICE devdesc, char *roothubserial, char *request, int requestsize, int *neededsize);
@@ -260,6 +267,8 @@ YAPI_FUNCTION ypSearch(const char *class_str, const char *func_str);
 int     ypGetFunctions(const char *class_str, YAPI_DEVICE devdesc, YAPI_FUNCTION prevfundesc,
                        YAPI_FUNCTION *buffer,int maxsize,int *neededsize);
 int     ypGetFunctionInfo(YAPI_FUNCTION fundesc, char *serial, char *funcId, char *baseType, char *funcName, char *funcVal);
+void    ypSetTimedReportTime(YAPI_FUNCTION fundesc, double deviceTime);
+int     ypGetFunctionsSnapshot(const char *class_str, yFunctionSnapshotSt *buffer, int maxsize, int *neededsize);
 #endif
 int     ypGetFunctionsEx(yStrRef categref, YAPI_DEVICE devdesc, YAPI_FUNCTION prevfundesc, YAPI_FUNCTION *buffer, int maxsize, int *neededsize);
 int     wpGetDeviceInfo(YAPI_DEVICE devdesc, u16 *deviceid, char *productname, char *serial, char *logicalname, u8 *beacon);
@@ -56,6 +56,87 @@
 #endif
 #endif
 
+// Vectorized scanning of quoted strings, on hosts with SSE2 or NEON. Whitespace
+// and structural characters are still scanned byte by byte: the runs between
+// two tokens are mostly empty or a few bytes long, and a vectorized skip was
+// measured slower than the plain loops
+#if !defined(MICROCHIP_API) && !defined(YAPI_IN_YDEVICE)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YJSON_USE_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__GNUC__)
+#include <arm_neon.h>
+#define YJSON_USE_NEON
+#endif
+#endif
+
+#if defined(YJSON_USE_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+static int yJsonCtz(unsigned mask)
+{
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (int)idx;
+}
+#elif defined(YJSON_USE_SSE2)
+#define yJsonCtz(mask)  __builtin_ctz(mask)
+#endif
+
+// Return the number of characters before the first double-quote or
+// backslash, looking at most at len characters
+static int yJsonStringSpan(_FAR const char *src, int len)
+{
+    int n = 0;
+#if defined(YJSON_USE_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+
+    while(n + 16 <= len) {
+        __m128i blk = _mm_loadu_si128((const __m128i*)(src + n));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(blk, quote), _mm_cmpeq_epi8(blk, bslash)));
+        if(mask) return n + yJsonCtz((unsigned)mask);
+        n += 16;
+    }
+#elif defined(YJSON_USE_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t bslash = vdupq_n_u8('\\');
+
+    while(n + 16 <= len) {
+        uint8x16_t blk = vld1q_u8((const uint8_t*)(src + n));
+        uint8x16_t hit = vorrq_u8(vceqq_u8(blk, quote), vceqq_u8(blk, bslash));
+        // narrow each byte of the comparison to 4 bits of a 64-bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if(mask) return n + (__builtin_ctzll(mask) >> 2);
+        n += 16;
+    }
+#endif
+    while(n < len && src[n] != '"' && src[n] != '\\') n++;
+    return n;
+}
+
+// Return the number of characters before the first double-quote,
+// looking at most at len characters
+static int yJsonQuoteSpan(_FAR const char *src, int len)
+{
+#if !defined(MICROCHIP_API) && !defined(YAPI_IN_YDEVICE)
+    const char *q = (const char *)memchr(src, '"', len);
+    return (q ? (int)(q - src) : len);
+#else
+    int n = 0;
+    while(n < len && src[n] != '"') n++;
+    return n;
+#endif
+}
+
+#if !defined(MICROCHIP_API) && !defined(YAPI_IN_YDEVICE)
+#define yJsonCopy(dst, src, len)    memcpy(dst, src, len)
+#else
+static void yJsonCopy(char *dst, _FAR const char *src, int len)
+{
+    while(len-- > 0) *dst++ = *src++;
+}
+#endif
+
 #ifdef DEBUG_JSON_PARSE
 const char* yJsonStateStr[] = {
     "YJSON_HTTP_START",       // about to parse HTTP header, up to first space before return code
@@ -89,6 +170,7 @@ yJsonRetCode yJsonParse(yJsonStateMachine *j)
     char            *pt = j->pt;
     char            *ept = j->token + sizeof(j->token) - 1;
     unsigned char   c=0;
+    int             n;
 
 skip:
     res = YJSON_NEED_INPUT;
@@ -215,10 +297,12 @@ skip:
                 goto token_done;
             case YJSON_PARSE_STRING:     // parsing a quoted string
             case YJSON_PARSE_STRINGCONT: // parsing the continuation of a quoted string
-                while(src < end && pt < ept && (c = *src) != '"' && c != '\\') {
-                    *pt++ = c;
-                    src++;
-                }
+                n = (int)(end - src);
+                if(n > (int)(ept - pt)) n = (int)(ept - pt);
+                n = yJsonStringSpan(src, n);
+                yJsonCopy(pt, src, n);
+                pt += n;
+                src += n;
                 if(src >= end) goto done;
                 if(pt >= ept) {
                     *pt = 0;
@@ -227,7 +311,7 @@ skip:
                     res = YJSON_PARSE_AVAIL;
                     goto done;
                 }
-                src++; // skip double-quote or backslash
+                c = *src++; // skip double-quote or backslash
                 if(c == '"') goto token_done;
                 if (st == YJSON_PARSE_STRING) {
                     st = YJSON_PARSE_STRINGQ;
@@ -285,10 +369,12 @@ skip:
                 st = YJSON_PARSE_MEMBNAME;
                 // fall through
             case YJSON_PARSE_MEMBNAME:   // parsing a structure member name
-                while(src < end && pt < ept && (c = *src) != '"') {
-                    *pt++ = c;
-                    src++;
-                }
+                n = (int)(end - src);
+                if(n > (int)(ept - pt)) n = (int)(ept - pt);
+                n = yJsonQuoteSpan(src, n);
+                yJsonCopy(pt, src, n);
+                pt += n;
+                src += n;
                 if(src >= end) goto done;
                 if(pt >= ept) goto push_error;
                 src++;
@@ -369,6 +455,211 @@ void yJsonSkip(yJsonStateMachine *j, int nitems)
     j->skipcnt += nitems;
 }
 
+#if !defined(MICROCHIP_API) && !defined(YAPI_IN_YDEVICE)
+
+int yJsonStringSlice(yJsonStateMachine *j, yJsonSlice *slice)
+{
+    const char  *start = j->state_start + 1;
+    const char  *pos = j->src;
+    int         escaped = 0;
+
+    slice->ptr = j->token;
+    slice->len = (int)strlen(j->token);
+    slice->escaped = 0;
+    if(j->next != YJSON_PARSE_STRINGCONT) return 1;
+    // the string did not fit in the token buffer: locate its closing quote
+    // in the source, the parser never stops in the middle of an escape sequence
+    while(pos < j->end) {
+        pos += yJsonStringSpan(pos, (int)(j->end - pos));
+        if(pos >= j->end || *pos == '"') break;
+        escaped = 1;
+        pos += 2;
+    }
+    if(pos >= j->end) return 0;
+    if(!escaped && memchr(start, '\\', j->src - start)) escaped = 1;
+    slice->ptr = start;
+    slice->len = (int)(pos - start);
+    slice->escaped = escaped;
+    j->src = pos + 1;
+    j->pt = j->token;
+    j->token[0] = 0;
+    j->next = YJSON_PARSE_DONE;
+    j->state_end = j->src;
+    return 1;
+}
+
+int yJsonUnescape(const char *src, int len, char *dst, int dstsize)
+{
+    const char  *end = src + len;
+    char        *d = dst;
+    char        c;
+
+    while(src < end && d < dst + dstsize) {
+        c = *src++;
+        if(c == '\\' && src < end) {
+            c = *src++;
+            switch(c) {
+                case 'r': c = '\r'; break;
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+            }
+        }
+        *d++ = c;
+    }
+    return (int)(d - dst);
+}
+
+// Return the offset just past the closing quote of the string starting at pos, or -1
+static int yJsonIndexSkipString(const char *json, int pos, int len)
+{
+    pos++;
+    while(pos < len) {
+        pos += yJsonStringSpan(json + pos, len - pos);
+        if(pos >= len) break;
+        if(json[pos] == '"') return pos + 1;
+        pos += 2; // skip backslash and quoted character
+    }
+    return -1;
+}
+
+static int yJsonIndexNewNode(yJsonIndex *idx)
+{
+    if(idx->count == idx->size) {
+        int newsize = (idx->size ? 2 * idx->size : 64);
+        yJsonNode *tmp = (yJsonNode*)realloc(idx->nodes, newsize * sizeof(yJsonNode));
+        if(!tmp) return -1;
+        idx->nodes = tmp;
+        idx->size = newsize;
+    }
+    return idx->count++;
+}
+
+int yJsonIndexBuild(yJsonIndex *idx, const char *json, int len)
+{
+    int     pos = 0, cur = -1, last = -1, n;
+    int     name = -1, namelen = 0;
+    char    c;
+
+    idx->count = 0;
+    for(;;) {
+        while(pos < len && ((c = json[pos]) == ' ' || c == '\r' || c == '\n' || c == '\t')) pos++;
+        if(pos >= len) return -1;
+        c = json[pos];
+        if(cur >= 0 && c == ',') {
+            pos++;
+            continue;
+        }
+        if(c == '}' || c == ']') {
+            if(cur < 0 || name >= 0) return -1;
+            if(idx->nodes[cur].type != (c == '}' ? YJSON_PARSE_STRUCT : YJSON_PARSE_ARRAY)) return -1;
+            idx->nodes[cur].end = ++pos;
+            last = cur;
+            cur = idx->nodes[cur].parent;
+            if(cur < 0) return idx->count;
+            continue;
+        }
+        if(cur >= 0 && idx->nodes[cur].type == YJSON_PARSE_STRUCT && name < 0) {
+            // member name, followed by a colon
+            if(c != '"') return -1;
+            name = pos + 1;
+            pos = yJsonIndexSkipString(json, pos, len);
+            if(pos < 0) return -1;
+            namelen = pos - 1 - name;
+            while(pos < len && ((c = json[pos]) == ' ' || c == '\r' || c == '\n' || c == '\t')) pos++;
+            if(pos >= len || json[pos] != ':') return -1;
+            pos++;
+            continue;
+        }
+        // value: add a node and link it to its parent and previous sibling
+        n = yJsonIndexNewNode(idx);
+        if(n < 0) return -1;
+        idx->nodes[n].start = pos;
+        idx->nodes[n].name = name;
+        idx->nodes[n].namelen = (name >= 0 ? namelen : 0);
+        idx->nodes[n].parent = cur;
+        idx->nodes[n].next = -1;
+        idx->nodes[n].child = -1;
+        if(last >= 0) {
+            idx->nodes[last].next = n;
+        } else if(cur >= 0) {
+            idx->nodes[cur].child = n;
+        }
+        name = -1;
+        if(c == '{' || c == '[') {
+            idx->nodes[n].type = (c == '{' ? YJSON_PARSE_STRUCT : YJSON_PARSE_ARRAY);
+            pos++;
+            cur = n;
+            last = -1;
+            continue;
+        }
+        if(c == '"') {
+            idx->nodes[n].type = YJSON_PARSE_STRING;
+            pos = yJsonIndexSkipString(json, pos, len);
+            if(pos < 0) return -1;
+        } else if(c == '-' || (c >= '0' && c <= '9')) {
+            idx->nodes[n].type = YJSON_PARSE_NUM;
+            while(pos < len && ((c = json[pos]) == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' || (c >= '0' && c <= '9'))) pos++;
+        } else if(c >= 'A' && c <= 'z') {
+            idx->nodes[n].type = YJSON_PARSE_SYMBOL;
+            while(pos < len && (c = json[pos]) >= 'A' && c <= 'z') pos++;
+        } else {
+            return -1;
+        }
+        idx->nodes[n].end = pos;
+        if(cur < 0) return idx->count;
+        last = n;
+    }
+}
+
+int yJsonIndexMember(const yJsonIndex *idx, const char *json, int node, const char *name, int namelen)
+{
+    int n;
+
+    if(node < 0 || node >= idx->count || idx->nodes[node].type != YJSON_PARSE_STRUCT) return -1;
+    for(n = idx->nodes[node].child; n >= 0; n = idx->nodes[n].next) {
+        if(idx->nodes[n].namelen == namelen && memcmp(json + idx->nodes[n].name, name, namelen) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+int yJsonIndexItem(const yJsonIndex *idx, int node, int item)
+{
+    int n;
+
+    if(node < 0 || node >= idx->count || idx->nodes[node].type != YJSON_PARSE_ARRAY) return -1;
+    for(n = idx->nodes[node].child; n >= 0 && item > 0; n = idx->nodes[n].next) item--;
+    return n;
+}
+
+int yJsonIndexPath(const yJsonIndex *idx, const char *json, int node, const char *path)
+{
+    const char *p;
+
+    while(node >= 0 && *path) {
+        p = path;
+        while(*p && *p != '|') p++;
+        if(node < idx->count && idx->nodes[node].type == YJSON_PARSE_ARRAY) {
+            node = yJsonIndexItem(idx, node, atoi(path));
+        } else {
+            node = yJsonIndexMember(idx, json, node, path, (int)(p - path));
+        }
+        path = (*p ? p + 1 : p);
+    }
+    return node;
+}
+
+void yJsonIndexFree(yJsonIndex *idx)
+{
+    if(idx->nodes) free(idx->nodes);
+    idx->nodes = NULL;
+    idx->count = 0;
+    idx->size = 0;
+}
+
+#endif
+
 #if 0
 void yJsonInitEx(yJsonStateMachineEx *j, const char *jzon, int jzon_len, const char *ref, int ref_len)
 {
@@ -109,6 +109,61 @@ yJsonRetCode yJsonParse(yJsonStateMachine *j);
 // Mark next n JSON items in stream to be skipped (including content, in case items are containers)
 void         yJsonSkip(yJsonStateMachine *j, int nitems);
 
+#if !defined(MICROCHIP_API) && !defined(YAPI_IN_YDEVICE)
+
+// String value returned without copy, pointing either to the token buffer or to the source
+typedef struct {
+    const char  *ptr;           // first character of the string
+    int         len;            // length of the string, in bytes
+    int         escaped;        // raw JSON string with escape sequences, see yJsonUnescape
+} yJsonSlice;
+
+// Get a complete string value as a single slice, right after yJsonParse returned a
+// YJSON_PARSE_STRING token on a document held in a single source buffer.
+// Returns 1 if the slice covers the whole string (the parser is then positioned after it),
+// or 0 if the string ends beyond the source buffer and the slice only holds the first
+// fragment, in which case STRINGCONT fragments must still be read with yJsonParse
+int          yJsonStringSlice(yJsonStateMachine *j, yJsonSlice *slice);
+
+// Decode the escape sequences of a raw string slice into dst (up to dstsize bytes, not
+// null-terminated). Returns the number of bytes written
+int          yJsonUnescape(const char *src, int len, char *dst, int dstsize);
+
+// One entry of a JSON document index (tape), all positions are byte offsets in the document
+typedef struct {
+    yJsonState  type;           // YJSON_PARSE_STRUCT, _ARRAY, _STRING, _NUM or _SYMBOL
+    int         start;          // offset of the first character of the value
+    int         end;            // offset just past the last character of the value
+    int         name;           // offset of the raw member name (after the quote), -1 if none
+    int         namelen;        // length of the raw member name
+    int         parent;         // index of the enclosing container, -1 for the root
+    int         next;           // index of the next sibling, -1 if none
+    int         child;          // index of the first child of a container, -1 if none
+} yJsonNode;
+
+typedef struct {
+    yJsonNode   *nodes;         // nodes in document order, the root is node 0
+    int         count;          // number of valid nodes
+    int         size;           // number of allocated nodes
+} yJsonIndex;
+
+// Index a complete JSON document in a single pass (idx must be zeroed before first use).
+// Returns the number of nodes, or -1 if the document is truncated or invalid
+int          yJsonIndexBuild(yJsonIndex *idx, const char *json, int len);
+
+// Return the node of the named member of a struct node, or -1
+int          yJsonIndexMember(const yJsonIndex *idx, const char *json, int node, const char *name, int namelen);
+
+// Return the node of the n-th item of an array node, or -1
+int          yJsonIndexItem(const yJsonIndex *idx, int node, int item);
+
+// Resolve a path of member names and array indexes separated by '|' (as for yapiJsonGetPath)
+int          yJsonIndexPath(const yJsonIndex *idx, const char *json, int node, const char *path);
+
+void         yJsonIndexFree(yJsonIndex *idx);
+
+#endif
+
 #if 0
 
     typedef enum {
@@ -60,6 +60,7 @@ typedef  enum{
     YMEM_FREED
 } YMEM_STATE;
 
+// All links below are entry index + 1, so that 0 means "none"
 typedef struct{
     YMEM_STATE  state;
     const char *malloc_file;
@@ -68,14 +69,104 @@ typedef struct{
     const char *free_file;
     u32         free_line;
     void        *ptr;
+    u32         hnext;      // next entry in the same hash bucket
+    u32         hprev;      // previous entry in the same hash bucket
+    u32         fnext;      // next entry in the list of freed entries
+    u32         site;       // allocation call site
 } YMEM_ENTRY;
 
+// Aggregated statistics of one allocation call site
+typedef struct{
+    const char *file;
+    u32         line;
+    u32         count;      // live allocations
+    u32         size;       // live bytes
+    u32         peak;       // highest value of size
+    u32         total;      // number of allocations since init
+} YMEM_SITE;
+
+#define YMEM_SITE_COUNT     1024
+
 YMEM_ENTRY          *yMap    = NULL;
 u32                 yMapSize = 0;
 u32                 yMapUsed = 0;
 yCRITICAL_SECTION   yMapCS;
+static u32          *yMapHash = NULL;   // bucket heads, indexed by pointer hash
+static u32          yMapHashMask = 0;
+static u32          yMapFreedHead = 0;  // freed entries are recycled oldest first, so that
+static u32          yMapFreedTail = 0;  // double frees are reported for as long as possible
+static YMEM_SITE    ySites[YMEM_SITE_COUNT];
+static u32          ySitesUsed = 0;
+static int          yMapEnabled = 0;
+static u32          yMapUntracked = 0;  // allocations made while tracking was disabled
 
 
+static u32 ymemhash(void *ptr)
+{
+    u64 v = (u64)(size_t)ptr;
+    v ^= v >> 17;
+    v *= 0x9E3779B97F4A7C15ULL;
+    return (u32)(v >> 32) & yMapHashMask;
+}
+
+static YMEM_ENTRY* ymementry(void *ptr)
+{
+    u32 idx = yMapHash[ymemhash(ptr)];
+
+    // the most recent entry for a given pointer comes first in its bucket
+    while(idx) {
+        if(yMap[idx-1].ptr == ptr)
+            return yMap + idx - 1;
+        idx = yMap[idx-1].hnext;
+    }
+    return NULL;
+}
+
+static void ymemunlink(YMEM_ENTRY *entry)
+{
+    if(entry->hprev) {
+        yMap[entry->hprev-1].hnext = entry->hnext;
+    } else {
+        yMapHash[ymemhash(entry->ptr)] = entry->hnext;
+    }
+    if(entry->hnext) {
+        yMap[entry->hnext-1].hprev = entry->hprev;
+    }
+    entry->hnext = entry->hprev = 0;
+}
+
+static void ymemlink(YMEM_ENTRY *entry)
+{
+    u32 *head = yMapHash + ymemhash(entry->ptr);
+
+    entry->hprev = 0;
+    entry->hnext = *head;
+    if(*head) {
+        yMap[*head-1].hprev = (u32)(entry - yMap) + 1;
+    }
+    *head = (u32)(entry - yMap) + 1;
+}
+
+static u32 ymemsite(const char *file, u32 line)
+{
+    u32 i = (u32)(((size_t)file >> 3) ^ (line * 2654435761u)) & (YMEM_SITE_COUNT-1);
+    u32 probe;
+
+    for(probe = 0; probe < YMEM_SITE_COUNT; probe++, i = (i+1) & (YMEM_SITE_COUNT-1)) {
+        if(ySites[i].file == file && ySites[i].line == line)
+            return i + 1;
+        if(ySites[i].file == NULL) {
+            if(ySitesUsed >= YMEM_SITE_COUNT - YMEM_SITE_COUNT/4)
+                return 0; // keep the table sparse, sites beyond are not aggregated
+            ySites[i].file = file;
+            ySites[i].line = line;
+            ySitesUsed++;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
 
 static void ymemdumpentry(YMEM_ENTRY *entry,const char* prefix)
 {
@@ -86,73 +177,80 @@ static void ymemdumpentry(YMEM_ENTRY *entry,const char* prefix)
 static void  ymemdump(void)
 {
     u32 i;
-    YMEM_ENTRY *entry;
+    YMEM_SITE *site;
     u32 total,count;
 
-    dbglog("ySafeMemoryDump: %d/%d entry\n\n", yMapUsed, yMapSize);
+    dbglog("ySafeMemoryDump: %d/%d entry (%d untracked)\n\n", yMapUsed, yMapSize, yMapUntracked);
     dbglog("Malloc:\n");
     total=count=0;
-    for(i=0, entry=yMap; i< yMapUsed ; i++,entry++){
-        if(entry->state == YMEM_MALLOCED){
-            ymemdumpentry(entry,"");
-            dbglog("%s : %d of %db (0x%x)\n", entry->malloc_file, entry->malloc_line, entry->malloc_size, entry->ptr);
-            total+= entry->malloc_size;
-            count++;
+    for(i=0, site=ySites; i < YMEM_SITE_COUNT ; i++,site++){
+        if(site->count){
+            dbglog("%s : %d : %d live of %db (peak %db, %d allocations)\n", site->file, site->line, site->count, site->size, site->peak, site->total);
+            total+= site->size;
+            count+= site->count;
         }
     }
     dbglog("total: %db (%d Kb) on %d entry\n\n",total,(int)(total/1024),count);
-#if 0
-    dbglog("Free:\n");
-    for(i=0, entry=yMap; i< yMapUsed ; i++,entry++){
-        if(entry->state == YMEM_FREED){
-            dbglog("alloc %s:%d of %db, free %s:%d\n",entry->malloc_file,entry->malloc_line,entry->malloc_size,entry->free_file,entry->free_line);
-        }
-    }
-#endif
 }
 
 
 
 void ySafeMemoryInit(u32 nbentry)
 {
+    u32 nbbucket = 1;
+
     YASSERT(yMap==NULL);
     YASSERT(yMapSize==0);
+    while(nbbucket < nbentry) nbbucket <<= 1;
     yInitializeCriticalSection(&yMapCS);
     yEnterCriticalSection(&yMapCS);
     yMap = malloc(nbentry *sizeof(YMEM_ENTRY));
-    if(yMap){
+    yMapHash = malloc(nbbucket * sizeof(u32));
+    if(yMap && yMapHash){
         yMapSize = nbentry;
         memset(yMap,0,nbentry *sizeof(YMEM_ENTRY));
+        memset(yMapHash,0,nbbucket * sizeof(u32));
+        yMapHashMask = nbbucket - 1;
         yMapUsed=0;
+        yMapEnabled = 1;
     }
+    yMapFreedHead = yMapFreedTail = 0;
+    memset(ySites, 0, sizeof(ySites));
+    ySitesUsed = 0;
+    yMapUntracked = 0;
+    yLeaveCriticalSection(&yMapCS);
+}
+
+// Tracking can be switched off at runtime, allocations made meanwhile are
+// simply passed through and their free is not checked
+void ySafeMemoryEnable(int enable)
+{
+    yEnterCriticalSection(&yMapCS);
+    yMapEnabled = (enable && yMap != NULL);
     yLeaveCriticalSection(&yMapCS);
 }
 
 void *ySafeMalloc(const char *file,u32 line,u32 size)
 {
-    u32 i;
     YMEM_ENTRY *entry;
+    YMEM_SITE *site;
     void *ptr;
 
     yEnterCriticalSection(&yMapCS);
-    if(yMapUsed < yMapSize){
-        //use a new one
-        entry=yMap+yMapUsed;
-    }else{
-        // find a freed entry
-        for(i=0; i< yMapSize;i++){
-            if(yMap[i].state == YMEM_FREED)
-                break;
+    if(!yMapEnabled){
+        ptr = malloc(size);
+        if(ptr){
+            yMapUntracked++;
+            // a freed entry still holding this address is stale now, so
+            // that freeing the new block is not reported as a double free
+            entry = (yMapHash ? ymementry(ptr) : NULL);
+            if(entry && entry->state == YMEM_FREED){
+                entry->state = YMEM_NOT_USED;
+            }
         }
-        if(i==yMapSize){
-            dbglog("No more entry available for ySafeMalloc\n\n");
-            ymemdump();
-            yLeaveCriticalSection(&yMapCS);
-            return NULL;
-        }
-        entry = yMap+i;
+        yLeaveCriticalSection(&yMapCS);
+        return ptr;
     }
-
     ptr=malloc(size);
     if(!ptr){
         dbglog("No more memory available (unable to allocate %d bytes)\n\n",size);
@@ -161,14 +259,39 @@ void *ySafeMalloc(const char *file,u32 line,u32 size)
         return NULL;
     }
 
+    if(yMapUsed < yMapSize){
+        //use a new one
+        entry=yMap+yMapUsed;
+        yMapUsed++;
+    }else if(yMapFreedHead){
+        // recycle the oldest freed entry
+        entry = yMap + yMapFreedHead - 1;
+        yMapFreedHead = entry->fnext;
+        if(!yMapFreedHead) yMapFreedTail = 0;
+        ymemunlink(entry);
+    }else{
+        dbglog("No more entry available for ySafeMalloc\n\n");
+        ymemdump();
+        free(ptr);
+        yLeaveCriticalSection(&yMapCS);
+        return NULL;
+    }
+
     memset(entry,0,sizeof(YMEM_ENTRY));
     entry->state = YMEM_MALLOCED;
     entry->malloc_file = file;
     entry->malloc_line = line;
     entry->ptr  = ptr;
     entry->malloc_size = size;
-    if(yMapUsed < yMapSize)
-        yMapUsed++;
+    entry->site = ymemsite(file, line);
+    if(entry->site){
+        site = ySites + entry->site - 1;
+        site->count++;
+        site->size += size;
+        site->total++;
+        if(site->size > site->peak) site->peak = site->size;
+    }
+    ymemlink(entry);
     yLeaveCriticalSection(&yMapCS);
 
     return ptr;
@@ -176,19 +299,24 @@ void *ySafeMalloc(const char *file,u32 line,u32 size)
 
 void  ySafeFree(const char *file,u32 line,void *ptr)
 {
-    u32 i;
     YMEM_ENTRY *entry;
+    YMEM_SITE *site;
+    u32 idx;
 
     yEnterCriticalSection(&yMapCS);
-    for(i=0, entry=yMap; i< yMapUsed ; i++,entry++){
-        YASSERT(entry->state != YMEM_NOT_USED);
-        if(entry->ptr == ptr)
-            break;
-    }
-    if(i == yMapUsed){
+    entry = ymementry(ptr);
+    if(entry == NULL || entry->state == YMEM_NOT_USED){
+        if(yMapUntracked){
+            // may have been allocated while tracking was disabled
+            free(ptr);
+            yLeaveCriticalSection(&yMapCS);
+            return;
+        }
         dbglog("Free of unallocated pointer 0x%x at %s:%d\n\n",ptr,file,line);
         ymemdump();
         YASSERT(0);
+        yLeaveCriticalSection(&yMapCS);
+        return;
     }
     if(entry->state == YMEM_FREED){
         dbglog("Free of allready freed pointer (0x%x) at %s:%d\n",ptr,file,line);
@@ -196,31 +324,46 @@ void  ySafeFree(const char *file,u32 line,void *ptr)
             entry->malloc_file, entry->malloc_line, entry->malloc_size, entry->free_file,entry->free_line);
         ymemdump();
         YASSERT(0);
+        yLeaveCriticalSection(&yMapCS);
+        return;
     }
     free(entry->ptr);
+    if(entry->site){
+        site = ySites + entry->site - 1;
+        site->count--;
+        site->size -= entry->malloc_size;
+    }
     entry->free_file = file;
     entry->free_line = line;
     entry->state = YMEM_FREED;
-    entry->ptr=NULL;
+    // the freed entry stays in its hash bucket to detect double frees until it is recycled
+    idx = (u32)(entry - yMap) + 1;
+    entry->fnext = 0;
+    if(yMapFreedTail){
+        yMap[yMapFreedTail-1].fnext = idx;
+    } else {
+        yMapFreedHead = idx;
+    }
+    yMapFreedTail = idx;
 
     yLeaveCriticalSection(&yMapCS);
 }
 
 void  ySafeTrace(const char *file,u32 line,void *ptr)
 {
-    u32 i;
     YMEM_ENTRY *entry;
+    YMEM_SITE *site;
 
     yEnterCriticalSection(&yMapCS);
-    for(i=0, entry=yMap; i< yMapUsed ; i++,entry++){
-        YASSERT(entry->state != YMEM_NOT_USED);
-        if(entry->ptr == ptr)
-            break;
-    }
-    if(i == yMapUsed){
-        dbglog("Update trace of unallocated pointer 0x%x at %s:%d\n\n",ptr,file,line);
-        ymemdump();
-        YASSERT(0);
+    entry = ymementry(ptr);
+    if(entry == NULL || entry->state == YMEM_NOT_USED){
+        if(!yMapUntracked){
+            dbglog("Update trace of unallocated pointer 0x%x at %s:%d\n\n",ptr,file,line);
+            ymemdump();
+            YASSERT(0);
+        }
+        yLeaveCriticalSection(&yMapCS);
+        return;
     }
     if(entry->state == YMEM_FREED){
         dbglog("Update trace of allready freed pointer (0x%x) at %s:%d\n",ptr,file,line);
@@ -228,25 +371,43 @@ void  ySafeTrace(const char *file,u32 line,void *ptr)
                entry->malloc_file, entry->malloc_line, entry->malloc_size, entry->free_file,entry->free_line);
         ymemdump();
         YASSERT(0);
+        yLeaveCriticalSection(&yMapCS);
+        return;
     }
     ymemdumpentry(entry,"trace");
+    // move the allocation to the statistics of its new owner
+    if(entry->site){
+        site = ySites + entry->site - 1;
+        site->count--;
+        site->size -= entry->malloc_size;
+    }
     entry->malloc_file = file;
     entry->malloc_line = line;
+    entry->site = ymemsite(file, line);
+    if(entry->site){
+        site = ySites + entry->site - 1;
+        site->count++;
+        site->size += entry->malloc_size;
+        if(site->size > site->peak) site->peak = site->size;
+    }
     yLeaveCriticalSection(&yMapCS);
 }
 
 void  ySafeMemoryDump(void *discard)
 {
-    u32 i;
     YMEM_ENTRY *entry;
+    u32 live = 0;
+    u32 i;
 
     yEnterCriticalSection(&yMapCS);
-    for(i=0, entry=yMap; i< yMapUsed ; i++,entry++){
-        if(entry->state == YMEM_MALLOCED && entry->ptr!=discard){
-            break;
-        }
+    for(i=0; i < YMEM_SITE_COUNT; i++){
+        live += ySites[i].count;
     }
-    if(i< yMapUsed){
+    entry = (discard ? ymementry(discard) : NULL);
+    if(entry && entry->state == YMEM_MALLOCED && live > 0){
+        live--;
+    }
+    if(live){
         ymemdump();
     } else {
         dbglog("No memory leak detected\n");
@@ -259,13 +420,207 @@ void  ySafeMemoryStop(void)
 {
     yDeleteCriticalSection(&yMapCS);
     free(yMap);
+    free(yMapHash);
     yMap=NULL;
+    yMapHash=NULL;
     yMapSize = yMapUsed = 0;
+    yMapHashMask = 0;
+    yMapFreedHead = yMapFreedTail = 0;
+    yMapEnabled = 0;
 }
 
 #endif
 
 
+// bytes held by each subsystem (see yapiSetMemoryLimit), kept across yInitAPI/yFreeAPI
+static volatile u32 yMemUsed[YAPI_MEM_COUNT];
+static volatile u32 yMemPeak[YAPI_MEM_COUNT];
+static volatile u32 yMemLimit[YAPI_MEM_COUNT];
+
+void yMemCharge(int memsub, u32 size)
+{
+    u32 used, peak;
+
+    used = yAtomicAdd32(&yMemUsed[memsub], size);
+    do {
+        peak = yAtomicLoad32(&yMemPeak[memsub]);
+    } while(used > peak && !yAtomicCAS32(&yMemPeak[memsub], peak, used));
+}
+
+void yMemUncharge(int memsub, u32 size)
+{
+    yAtomicAdd32(&yMemUsed[memsub], 0 - size);
+}
+
+int yMemOverLimit(int memsub, u32 size)
+{
+    u32 limit = yAtomicLoad32(&yMemLimit[memsub]);
+
+    return (limit != 0 && yAtomicLoad32(&yMemUsed[memsub]) + size > limit);
+}
+
+void yMemSetLimit(int memsub, u32 limit)
+{
+    yAtomicStore32(&yMemLimit[memsub], limit);
+}
+
+void yMemGetStats(int memsub, u32 *used, u32 *peak, u32 *limit)
+{
+    if(used) *used = yAtomicLoad32(&yMemUsed[memsub]);
+    if(peak) *peak = yAtomicLoad32(&yMemPeak[memsub]);
+    if(limit) *limit = yAtomicLoad32(&yMemLimit[memsub]);
+}
+
+
+void yPoolInit(yPool *pool, u32 itemsize, u32 maxfree, int memsub)
+{
+    memset(pool, 0, sizeof(yPool));
+    yInitializeCriticalSection(&pool->cs);
+    pool->itemsize = (itemsize < sizeof(yPoolItem) ? (u32)sizeof(yPoolItem) : itemsize);
+    pool->memsub = memsub;
+    pool->maxfree = maxfree;
+}
+
+#ifdef YSAFE_MEMORY
+// the heap allocation is recorded against the caller of yPoolAlloc
+void* yPoolAllocEx(const char *file, u32 line, yPool *pool)
+#else
+void* yPoolAlloc(yPool *pool)
+#endif
+{
+    yPoolItem *item;
+
+    yEnterCriticalSection(&pool->cs);
+    item = pool->freelist;
+    if(item) {
+        pool->freelist = item->next;
+        pool->nbfree--;
+        pool->reused++;
+    } else {
+        pool->allocated++;
+    }
+    if(++pool->inuse > pool->peak) pool->peak = pool->inuse;
+    yLeaveCriticalSection(&pool->cs);
+    // only the items in use are charged, so that the free list never holds
+    // the subsystem over its limit
+    yMemCharge(pool->memsub, pool->itemsize);
+    if(!item) {
+#ifdef YSAFE_MEMORY
+        item = (yPoolItem*)ySafeMalloc(file, line, pool->itemsize);
+#else
+        item = (yPoolItem*)yMalloc(pool->itemsize);
+#endif
+    }
+    return item;
+}
+
+
+void yPoolRelease(yPool *pool, void *ptr)
+{
+    yPoolItem *item = (yPoolItem*)ptr;
+
+    yEnterCriticalSection(&pool->cs);
+    pool->inuse--;
+#ifndef YSAFE_MEMORY
+    // with YSAFE_MEMORY, ySafeFree sees every release to keep double free detection
+    if(pool->nbfree < pool->maxfree) {
+        item->next = pool->freelist;
+        pool->freelist = item;
+        pool->nbfree++;
+        item = NULL;
+    }
+#endif
+    yLeaveCriticalSection(&pool->cs);
+    yMemUncharge(pool->memsub, pool->itemsize);
+    if(item) {
+        yFree(item);
+    }
+}
+
+void yPoolFree(yPool *pool)
+{
+    yPoolItem *item;
+
+    while(pool->freelist) {
+        item = pool->freelist;
+        pool->freelist = item->next;
+        yFree(item);
+    }
+    pool->nbfree = 0;
+    yDeleteCriticalSection(&pool->cs);
+}
+
+void yPoolsInit(yContextSt *ctx)
+{
+    int k;
+
+    yPoolInit(&ctx->reqPool, sizeof(RequestSt), 16, YAPI_MEM_NET);
+    yPoolInit(&ctx->pktPool, sizeof(pktItem), 256, YAPI_MEM_USB);
+    yPoolInit(&ctx->iohdlPool, sizeof(YIOHDL_internal), 16, YAPI_MEM_NET);
+    for(k = 0; k < YBUF_POOL_CLASSES; k++) {
+        // keep fewer large buffers than small ones
+        yPoolInit(&ctx->bufPool[k], 1u << (YBUF_POOL_MIN_SHIFT + k), (k < 4 ? 64u >> k : 4), YAPI_MEM_NET);
+    }
+}
+
+void yPoolsFree(yContextSt *ctx)
+{
+    int k;
+
+    yPoolFree(&ctx->reqPool);
+    yPoolFree(&ctx->pktPool);
+    yPoolFree(&ctx->iohdlPool);
+    for(k = 0; k < YBUF_POOL_CLASSES; k++) {
+        yPoolFree(&ctx->bufPool[k]);
+    }
+}
+
+// Return the size class of a buffer, or -1 if it is too large to be pooled
+static int yBufClass(int size)
+{
+    int k = 0;
+
+    while(k < YBUF_POOL_CLASSES && (1 << (YBUF_POOL_MIN_SHIFT + k)) < size) k++;
+    return (k < YBUF_POOL_CLASSES ? k : -1);
+}
+
+#ifdef YSAFE_MEMORY
+void* yBufAllocEx(const char *file, u32 line, int *size)
+#else
+void* yBufAlloc(int *size)
+#endif
+{
+    int k = yBufClass(*size);
+
+    if(k < 0) {
+        yMemCharge(YAPI_MEM_NET, *size);
+#ifdef YSAFE_MEMORY
+        return ySafeMalloc(file, line, *size);
+#else
+        return yMalloc(*size);
+#endif
+    }
+    *size = 1 << (YBUF_POOL_MIN_SHIFT + k);
+#ifdef YSAFE_MEMORY
+    return yPoolAllocEx(file, line, &yContext->bufPool[k]);
+#else
+    return yPoolAlloc(&yContext->bufPool[k]);
+#endif
+}
+
+void yBufRelease(void *buf, int size)
+{
+    int k = yBufClass(size);
+
+    if(k < 0 || size != (1 << (YBUF_POOL_MIN_SHIFT + k))) {
+        yFree(buf);
+        yMemUncharge(YAPI_MEM_NET, size);
+        return;
+    }
+    yPoolRelease(&yContext->bufPool[k], buf);
+}
+
+
 // return the min of strlen and maxlen
 static unsigned ystrnlen(const char *src,unsigned maxlen)
 {
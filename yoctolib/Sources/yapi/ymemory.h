@@ -43,6 +43,7 @@
 
 #ifdef YSAFE_MEMORY
 void  ySafeMemoryInit(u32 nbentry);
+void  ySafeMemoryEnable(int enable);
 void* ySafeMalloc(const char *file,u32 line,u32 size);
 void  ySafeFree(const char *file,u32 line,void *ptr);
 void  ySafeTrace(const char *file,u32 line,void *ptr);
@@ -50,6 +51,7 @@ void  ySafeMemoryDump(void *discard);
 void  ySafeMemoryStop(void);
 #else
 #define ySafeMemoryInit(nbentry) {}
+#define ySafeMemoryEnable(enable) {}
 #define ySafeMemoryDump(discard) {}
 #define ySafeMemoryStop() {}
 #endif
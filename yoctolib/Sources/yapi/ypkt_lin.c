@@ -269,6 +269,7 @@ static void *event_thread(void *param)
 {
     yContextSt *ctx = (yContextSt*)param;
     char            errmsg[YOCTO_ERRMSG_LEN];
+    yThreadApplyRole(YAPI_THREAD_USB);
     ctx->usb_thread_state = USB_THREAD_RUNNING;
     /* Non-blocking. See if the OS has any reports to give. */
     HALLOG("Start event_thread run loop\n");
@@ -577,7 +578,7 @@ static void wr_callback(struct libusb_transfer *transfer)
         //HALLOG("CBwr:%s pkt_sent (len=%d)\n",iface->serial, transfer->actual_length);
         // remove sent packet
         yPktQueuePopH2D(iface, &pktitem);
-        yFree(pktitem);
+        yPoolRelease(&yContext->pktPool, pktitem);
 #if 0
         // following code make no sense and failed on very slow computer
         // (the main thread queue a new packet durring the yFree(pktitem);
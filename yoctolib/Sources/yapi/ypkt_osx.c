@@ -109,6 +109,7 @@ static void *event_thread(void *param)
 {
     yContextSt  *ctx=param;
 
+    yThreadApplyRole(YAPI_THREAD_USB);
     ctx->usb_run_loop     = CFRunLoopGetCurrent();
     ctx->usb_thread_state = USB_THREAD_RUNNING;
     /* Non-blocking. See if the OS has any reports to give. */
@@ -484,14 +485,14 @@ int yyySignalOutPkt(yInterfaceSt *iface, char *errmsg)
     yPktQueuePopH2D(iface, &pktitem);
     while (pktitem!=NULL){
         if(iface->devref==NULL){
-            yFree(pktitem);
+            yPoolRelease(&yContext->pktPool, pktitem);
             return YERR(YAPI_IO_ERROR);
         }
         res = IOHIDDeviceSetReport(iface->devref,
                                    kIOHIDReportTypeOutput,
                                    0, /* Report ID*/
                                    (u8*)&pktitem->pkt, sizeof(USB_Packet));
-        yFree(pktitem);
+        yPoolRelease(&yContext->pktPool, pktitem);
         if (res != kIOReturnSuccess) {
             dbglog("IOHIDDeviceSetReport failed with 0x%x\n", res);
             return YERRMSG(YAPI_IO_ERROR,"IOHIDDeviceSetReport failed");;
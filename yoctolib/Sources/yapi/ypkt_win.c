@@ -818,6 +818,7 @@ static void* yyyUsbIoThread(void* thread_void)
     yInterfaceSt    *iface = (yInterfaceSt*)thread->ctx;
 
 
+    yThreadApplyRole(YAPI_THREAD_USB);
     iface->wrHDL = INVALID_HANDLE_VALUE;
     iface->rdHDL = INVALID_HANDLE_VALUE;
     for (i = 0; i < 2; i++) {
@@ -884,7 +885,7 @@ static void* yyyUsbIoThread(void* thread_void)
             }
             YASSERT(timeAfterWrite >= 0 && timeAfterWrite < 50);
 #endif
-            yFree(pktItem);
+            yPoolRelease(&yContext->pktPool, pktItem);
             yPktQueuePeekH2D(iface, &pktItem);
         }
 
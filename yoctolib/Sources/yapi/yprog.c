@@ -409,7 +409,7 @@ int ypGetBootloaderReply(BootloaderSt *dev, USB_Packet *pkt,char *errmsg)
     if(ptr){
         yTracePtr(ptr);
         memcpy(pkt,&ptr->pkt,sizeof(USB_Packet));
-        yFree(ptr);
+        yPoolRelease(&yContext->pktPool, ptr);
         return 0;
     }
 	return YAPI_TIMEOUT; // not a fatal error, handled by caller
@@ -427,7 +427,7 @@ int BlockingRead(BootloaderSt *dev,USB_Packet *pkt, int maxwait, char *errmsg)
     if (ptr) {
 	    yTracePtr(ptr);
 		memcpy(pkt,&ptr->pkt,sizeof(USB_Packet));
-		yFree(ptr);
+		yPoolRelease(&yContext->pktPool, ptr);
         return YAPI_SUCCESS;
 	}
 	return YERR(YAPI_TIMEOUT);
@@ -516,6 +516,10 @@ static int yLoadFirmwareFile(const char * filename, u8 **buffer, char *errmsg)
         fclose(f);
         return YERR(YAPI_IO_ERROR);
     }
+    if (yMemOverLimit(YAPI_MEM_FIRMWARE, size)) {
+        fclose(f);
+        return YERRMSG(YAPI_EXHAUSTED, "Firmware exceeds the memory limit");
+    }
     ptr = yMalloc(size);
     if (ptr == NULL) {
         fclose(f);
@@ -1633,13 +1637,20 @@ static int upload(const char *hubserial, const char *subpath, const char *filena
 
     char       *p;
     int         buffer_size = 1024 + data_len;
-    char        *buffer = yMalloc(buffer_size);
+    int         charged = buffer_size;
+    char        *buffer;
     char        boundary[32];
     int         res;
     YIOHDL      iohdl;
     char    *reply = NULL;
     int     replysize = 0;
 
+    if (yMemOverLimit(YAPI_MEM_FIRMWARE, charged)) {
+        return YERRMSG(YAPI_EXHAUSTED, "Upload exceeds the memory limit");
+    }
+    buffer = yMalloc(buffer_size);
+    yMemCharge(YAPI_MEM_FIRMWARE, charged);
+
     do {
         YSPRINTF(boundary, 32, "Zz%06xzZ", rand() & 0xffffff);
     } while (ymemfind(data, data_len, (u8*)boundary, YSTRLEN(boundary)) >= 0);
@@ -1673,6 +1684,7 @@ static int upload(const char *hubserial, const char *subpath, const char *filena
         yapiHTTPRequestSyncDone_internal(&iohdl, errmsg);
     }
     yFree(buffer);
+    yMemUncharge(YAPI_MEM_FIRMWARE, charged);
     return res;
 }
 
@@ -1766,6 +1778,10 @@ static int yDownloadFirmware(const char * url, u8 **out_buffer, char *errmsg)
     }
     ofs += 4;
     len = res - ofs;
+    if (yMemOverLimit(YAPI_MEM_FIRMWARE, len)) {
+        yFree(buffer);
+        return YERRMSG(YAPI_EXHAUSTED, "Firmware exceeds the memory limit");
+    }
     *out_buffer = yMalloc(len);
     memcpy(*out_buffer, buffer + ofs, len);
     yFree(buffer);
@@ -1798,6 +1814,7 @@ static void* yFirmwareUpdate_thread(void* ctx)
     YPROG_RESULT u_flash_res;
 
 
+    yThreadApplyRole(YAPI_THREAD_FIRMWARE);
     yThreadSignalStart(thread);
 
     //1% -> 5%
@@ -1813,6 +1830,7 @@ static void* yFirmwareUpdate_thread(void* ctx)
         goto exitthread;
     }
     fctx.len = res;
+    yMemCharge(YAPI_MEM_FIRMWARE, fctx.len);
     //copy firmware header into context variable (to have same behaviour as a device)
     memcpy(&fctx.bynHead, fctx.firmware, sizeof(fctx.bynHead));
     YSTRCPY(fctx.bynHead.h.serial, YOCTO_SERIAL_LEN, yContext->fuCtx.serial);
@@ -2098,6 +2116,7 @@ exit_and_free:
 
     if (fctx.firmware) {
         yFree(fctx.firmware);
+        yMemUncharge(YAPI_MEM_FIRMWARE, fctx.len);
         fctx.firmware = NULL;
     }
 
@@ -506,6 +506,7 @@ typedef struct {
 // packet queue stuff
 typedef struct _pktItem{
     USB_Packet          pkt;
+    u64                 rxtime;     // arrival of device to host packets, in yapiGetTickCountUs() units
 #ifdef DEBUG_PKT_TIMING
     u64                 time;
     u64                 ospktno;
@@ -646,6 +647,27 @@ typedef enum
 #define DEVGEN_LOG_ACTIVATED     1u
 #define DEVGEN_LOG_PENDING       2u
 #define DEVGEN_LOG_PULLING       4u
+#define DEVGEN_LOG_QUEUED        8u     // devYdx is in the pending log queue
+// Device clock model, fitted from the arrival time of the device time
+// packets. Transport delays only add positive jitter, so the model follows
+// the lower envelope of (host time - device time): the lowest offset seen
+// in each bucket of device time is kept, and a line is fitted through them.
+#define YCLOCK_NB_BUCKETS   16
+#define YCLOCK_BUCKET_SEC   10.0    // duration of a bucket, in device seconds
+#define YCLOCK_RESET_SEC    5.0     // restart the model on larger deviations
+#define YCLOCK_MAX_DRIFT    0.001   // 1000 ppm, far beyond any crystal
+typedef struct {
+    u32                 nbSamples;
+    u32                 lastBucket;                     // bucket number of the last sample
+    double              devRef;                         // device time of the first sample
+    double              lastDev;                        // device time of the last sample
+    u32                 bucketNum[YCLOCK_NB_BUCKETS];
+    double              bucketDev[YCLOCK_NB_BUCKETS];   // relative to devRef
+    double              bucketOfs[YCLOCK_NB_BUCKETS];   // lowest host-device offset of the bucket
+    double              offset;                         // host time - device time at devRef
+    double              drift;                          // relative drift of the device clock
+} yClockModel;
+
 typedef struct  _yGenericDeviceSt {
     yStrRef             serial; // set only once at init -> no need to use the mutex
     u32                 flags;
@@ -653,10 +675,15 @@ typedef struct  _yGenericDeviceSt {
     yFifoBuf            logFifo;
     u8*                 logBuffer;
     double              deviceTime;
+    yClockModel         clock;
 } yGenericDeviceSt;
 
 void initDevYdxInfos(int devYdxy, yStrRef serial);
 void freeDevYdxInfos(int devYdx);
+void yUpdateDeviceTime(int devYdx, double deviceTime, u64 rxtime);
+int  yNotifyDeviceLog(int devYdx);
+void yPullPendingDeviceLogs(void);
+int  yGetDeviceTime(int devYdx, double *deviceTime, double *hostTime);
 
 
 #define YIO_REMOTE_CLOSE 1u
@@ -816,6 +843,7 @@ typedef struct _HubSt {
     u64 attemptDelay;   // delay until next attemps (in ms)
     u64 devListExpires;
     u8 devYdxMap[ALLOC_YDX_PER_HUB];   // maps hub's internal devYdx to our WP devYdx //fixme:
+    int devYdxFromCache;    // devYdxMap loaded from the warm-start cache, not yet checked by an enumeration
     int errcode;  // in case an error occured
     char errmsg[YOCTO_ERRMSG_LEN];
     yCRITICAL_SECTION access; // CS for field that need to be protected agains concurency (these filed start with cs_
@@ -842,6 +870,7 @@ typedef struct _WSReqSt
     struct _RequestSt *next;
     u8* requestbuf; // Used to store the request to send
     int requestsize; // the size of the request
+    int requestbufsize; // allocated size of requestbuf
     int requestpos; // the pos of the request that need to be sent
     u64 first_write_tm;
     u64 last_write_tm;
@@ -917,6 +946,83 @@ typedef struct _YIOHDL_internal {
 } YIOHDL_internal;
 
 
+// function callback event, queued when an event queue is enabled
+#define YCBEV_VALUE         1
+#define YCBEV_NAME          2   // logical name change (value callback with NULL)
+#define YCBEV_NUMERIC       3
+#define YCBEV_TIMED         4
+#define YCBEV_MAX_REPORT    18
+#define YCBEV_LATEST_SIZE   1024  // latest value per function kept on overflow
+typedef struct {
+    u8                  type;
+    u8                  len;        // report length, or numeric value type
+    YAPI_FUNCTION       fundesc;
+    u64                 timestamp;
+    union {
+        char            value[YOCTO_PUBVAL_LEN];
+        double          numeric;
+        struct {
+            double      deviceTime;
+            double      hostTime;
+            u8          bytes[YCBEV_MAX_REPORT];
+        } report;
+    };
+} yCbEvent;
+
+// one queue of callback events, drained either by yapiHandleEvents or by
+// its own callback thread (see yapiSetCallbackThreads)
+#define YCBEV_MAX_THREADS   16
+typedef struct {
+    yLFQueue            queue;
+    yCRITICAL_SECTION   latest_cs;
+    yCbEvent            *latest;        // latest value per function, filled on overflow
+    yCbEvent            *latestSpare;
+    volatile u32        latestCount;
+    yThread             thread;
+    yEvent              wakeup;
+} yCbShard;
+
+// per-function value filter (see yapiSetFunctionValueFilter)
+#define YFUNFILTER_SIZE     1024
+#define YFUNFILTER_RAW      1   // pending value is a raw notification payload
+#define YFUNFILTER_STR      2   // pending value is a decoded string
+#define YFUNFILTER_IDLE     0xffffffff  // no value held back
+typedef struct {
+    YAPI_FUNCTION       fundesc;        // 0 for a free slot
+    u32                 minInterval;    // in ms, 0 to disable coalescing
+    double              deadband;       // 0 to disable the deadband
+    u64                 lastTime;       // time of the last delivered value
+    double              lastValue;      // last delivered numeric value
+    u8                  hasLastTime;
+    u8                  hasLastValue;
+    u8                  pending;        // YFUNFILTER_RAW, YFUNFILTER_STR or 0
+    u8                  pendingHasValue;
+    double              pendingValue;
+    Notification_funydx funInfo;
+    char                value[YOCTO_PUBVAL_LEN];
+} yFunFilter;
+
+// pool of fixed-size objects, released items are kept on a free list for reuse
+typedef struct _yPoolItem {
+    struct _yPoolItem   *next;
+} yPoolItem;
+
+typedef struct {
+    yCRITICAL_SECTION   cs;
+    u32                 itemsize;
+    u32                 maxfree;        // number of released items kept for reuse
+    yPoolItem           *freelist;
+    u32                 nbfree;
+    u32                 inuse;          // items currently handed out
+    u32                 peak;           // highest value of inuse
+    u32                 reused;         // allocations served from the free list
+    u32                 allocated;      // allocations that went to yMalloc
+    int                 memsub;         // YAPI_MEM_xxx subsystem charged for the heap allocations
+} yPool;
+
+#define YBUF_POOL_MIN_SHIFT 9           // smallest pooled buffer: 512 bytes
+#define YBUF_POOL_CLASSES   8           // largest pooled buffer: 64KB
+
 #define YCTX_OSX_MULTIPLES_HID 1
 // structure that contain information about the API
 typedef struct{
@@ -924,9 +1030,15 @@ typedef struct{
     yCRITICAL_SECTION   updateDev_cs;
     yCRITICAL_SECTION   handleEv_cs;
     yEvent              exitSleepEvent;
+    volatile int        eventFdRead;        // -1 until yapiGetEventFd is called
+    volatile int        eventFdWrite;
+    volatile u32        eventFdSignaled;
     // global inforation on all devices
     yCRITICAL_SECTION   generic_cs;
     yGenericDeviceSt    generic_infos[ALLOC_YDX_PER_HUB];
+    u8                  logQueue[ALLOC_YDX_PER_HUB];   // devYdx with pending logs, protected by generic_cs
+    u16                 logQueueHead;
+    u16                 logQueueCount;
     // usb stuff
     yCRITICAL_SECTION   enum_cs;
     int                 detecttype;
@@ -940,6 +1052,8 @@ typedef struct{
     u64                 deviceListValidityMs;
     // network discovery info
     HubSt*              nethub[NBMAX_NET_HUB];
+    u8                  *warmCache;     // warm-start cache, kept until all cached devices are reconciled
+    u32                 warmCacheSize;
     RequestSt*          tcpreq[ALLOC_YDX_PER_HUB];  // indexed by our own DevYdx
     yRawNotificationCb  rawNotificationCb;
     yRawReportCb        rawReportCb;
@@ -956,8 +1070,29 @@ typedef struct{
     yapiDeviceUpdateCallback    confChangeCallback;
     yapiDeviceUpdateCallback    removalCallback;
     yapiFunctionUpdateCallback  functionCallback;
+    yapiFunctionNumericCallback functionNumericCallback;
     yapiTimedReportCallback     timedReportCallback;
+    yapiTimedReportExCallback   timedReportExCallback;
     yapiHubDiscoveryCallback    hubDiscoveryCallback;
+    // function callback event queue (see yapiSetEventQueue)
+    int                 cbQueuePolicy;
+    int                 cbNbThreads;
+    int                 cbNbShards;
+    yCbShard            *cbShards;
+    yRWLOCK             cbThreadsLock;  // held for reading by callback threads, for writing by yapiLockFunctionCallBack
+    volatile u32        cbNbQueued;
+    volatile u32        cbNbDropped;
+    volatile u32        cbNbCoalesced;
+    // per-function value filters (see yapiSetFunctionValueFilter)
+    yCRITICAL_SECTION   funFilter_cs;
+    yFunFilter          *funFilters;
+    volatile u32        funFilterCount;     // number of active filters
+    volatile u32        funFilterPending;   // number of values held back
+    // pools of hot objects and of request/reply buffers (see yapiGetPoolStats)
+    yPool               reqPool;
+    yPool               pktPool;
+    yPool               iohdlPool;
+    yPool               bufPool[YBUF_POOL_CLASSES];
     // Programing api
     FUpdateContext      fuCtx;
     // OS specifics variables
@@ -986,7 +1121,40 @@ typedef struct{
 #endif
  } yContextSt;
 
+void  yPoolInit(yPool *pool, u32 itemsize, u32 maxfree, int memsub);
+#ifdef YSAFE_MEMORY
+// record pooled objects against the caller, as yMalloc does
+void* yPoolAllocEx(const char *file, u32 line, yPool *pool);
+#define yPoolAlloc(pool)                yPoolAllocEx(__FILE_ID__,__LINE__,pool)
+#else
+void* yPoolAlloc(yPool *pool);
+#endif
+void  yPoolRelease(yPool *pool, void *ptr);
+void  yPoolFree(yPool *pool);
+void  yPoolsInit(yContextSt *ctx);
+void  yPoolsFree(yContextSt *ctx);
+// *size is rounded up to the size class of the returned buffer, pass it back to yBufRelease
+#ifdef YSAFE_MEMORY
+void* yBufAllocEx(const char *file, u32 line, int *size);
+#define yBufAlloc(size)                 yBufAllocEx(__FILE_ID__,__LINE__,size)
+#else
+void* yBufAlloc(int *size);
+#endif
+void  yBufRelease(void *buf, int size);
+
+// memory accounting per subsystem (see yapiSetMemoryLimit)
+void  yMemCharge(int memsub, u32 size);
+void  yMemUncharge(int memsub, u32 size);
+// return 1 if allocating size more bytes would exceed the limit of the subsystem
+int   yMemOverLimit(int memsub, u32 size);
+void  yMemSetLimit(int memsub, u32 limit);
+void  yMemGetStats(int memsub, u32 *used, u32 *peak, u32 *limit);
+
+// apply the name, affinity and priority of a YAPI_THREAD_xxx role to the calling thread
+void  yThreadApplyRole(int role);
+
 #define TRACEFILE_NAMELEN  512
+#define WARMCACHE_NAMELEN  512
 
 extern char  ytracefile[];
 extern yContextSt  *yContext;
@@ -1078,7 +1246,9 @@ int handleNetNotification(HubSt *hub);
 u32 yapiGetCNonce(u32 nc);
 YRETCODE  yapiHTTPRequestSyncStartEx_internal(YIOHDL *iohdl, int tcpchan, const char *device, const char *request, int requestsize, char **reply, int *replysize, yapiRequestProgressCallback progress_cb, void *progress_ctx, char *errmsg);
 YRETCODE  yapiHTTPRequestSyncDone_internal(YIOHDL *iohdl, char *errmsg);
+void ySignalEvents(void);
 void yFunctionUpdate(YAPI_FUNCTION fundescr, const char *value);
-void yFunctionTimedUpdate(YAPI_FUNCTION fundescr, double deviceTime, const u8 *report, u32 len);
+void yFunctionValueUpdate(YAPI_FUNCTION fundescr, Notification_funydx funInfo, const char *funcval);
+void yFunctionTimedUpdate(YAPI_FUNCTION fundescr, double deviceTime, double hostTime, const u8 *report, u32 len);
 int yapiJsonGetPath_internal(const char *path, const char *json_data, int json_size, int withHTTPheader, const char **output, char *errmsg);
 #endif
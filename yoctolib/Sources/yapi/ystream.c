@@ -290,9 +290,7 @@ void ypUpdateYdx(int devydx, Notification_funydx funInfo, const char *funcval)
     if(ypRegisterByYdx(devydx, funInfo, funcval, &fundesc)){
         // Forward high-level notification to API user
         if (funcval) {
-            char buffer[YOCTO_PUBVAL_LEN];
-            decodePubVal(funInfo, funcval, buffer);
-            yFunctionUpdate(fundesc,buffer);
+            yFunctionValueUpdate(fundesc, funInfo, funcval);
         }
     }
 }
@@ -936,7 +934,7 @@ void yPktQueueFree(pktQueue *q)
     while(p){
         t=p;
         p=p->next;
-        yFree(t);
+        yPoolRelease(&yContext->pktPool, t);
     }
     yDeleteCriticalSection(&q->cs);
     yCloseEvent(&q->notEmptyEvent);
@@ -944,7 +942,7 @@ void yPktQueueFree(pktQueue *q)
     memset(q,0xca,sizeof(pktQueue));
 }
 
-static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, char * errmsg)
+static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, u64 rxtime, char * errmsg)
 {
     pktItem *newpkt;
     YRETCODE res;
@@ -958,8 +956,9 @@ static YRETCODE  yPktQueuePushEx(pktQueue *q,const USB_Packet *pkt, char * errms
     } else {
         res = YAPI_SUCCESS;
          // allocate new buffer
-        newpkt= ( pktItem *) yMalloc(sizeof(pktItem));
+        newpkt= ( pktItem *) yPoolAlloc(&yContext->pktPool);
         memcpy(&newpkt->pkt,pkt,sizeof(USB_Packet));
+        newpkt->rxtime = rxtime;
 #ifdef DEBUG_PKT_TIMING
         newpkt->time = yapiGetTickCount();
         newpkt->ospktno = q->totalPush;
@@ -1099,6 +1098,10 @@ static void yPktQueueDup(pktQueue *q, int expected_pkt_no, const char *file, int
 
 YRETCODE  yPktQueuePushD2H(yInterfaceSt *iface,const USB_Packet *pkt, char * errmsg)
 {
+    YRETCODE res;
+    // taken on the I/O thread, for the clock model of timed reports
+    u64 rxtime = yapiGetTickCountUs();
+
 #ifdef DUMP_USB_PKT_SHORT
     dumpPktSummary(iface->serial, iface->ifaceno,1,pkt);
 #endif
@@ -1125,7 +1128,10 @@ YRETCODE  yPktQueuePushD2H(yInterfaceSt *iface,const USB_Packet *pkt, char * err
     }
 #endif
 
-    return yPktQueuePushEx(&iface->rxQueue,pkt,errmsg);
+    res = yPktQueuePushEx(&iface->rxQueue,pkt,rxtime,errmsg);
+    // the packet will be processed by yapiHandleEvents
+    ySignalEvents();
+    return res;
 }
 
 YRETCODE yPktQueueWaitAndPopD2H(yInterfaceSt *iface,pktItem **pkt, int ms, char * errmsg)
@@ -1147,7 +1153,7 @@ YRETCODE yPktQueueWaitAndPopD2H(yInterfaceSt *iface,pktItem **pkt, int ms, char
 
 YRETCODE  yPktQueuePushH2D(yInterfaceSt *iface,const USB_Packet *pkt, char * errmsg)
 {
-    return yPktQueuePushEx(&iface->txQueue,pkt,errmsg);
+    return yPktQueuePushEx(&iface->txQueue,pkt,0,errmsg);
 }
 
 // return 1 if empty, 0 if not empty, or an error code
@@ -1271,7 +1277,7 @@ static int yyWaitOnlyConfPkt(yInterfaceSt *iface, u8 cmdtowait,pktItem **rpkt,u3
             }
 #endif
             dropcount++;
-            yFree(tmp);
+            yPoolRelease(&yContext->pktPool, tmp);
         }
     } while(timeout> yapiGetTickCount());
 
@@ -1346,7 +1352,7 @@ static int ySendStart(yPrivDeviceSt *dev,char *errmsg)
         dbglog("Activate USB pkt ack (%dms)\n", dev->pktAckDelay);
     }
     dev->lastpktno = rpkt->pkt.first_stream.pktno;
-    yFree(rpkt);
+    yPoolRelease(&yContext->pktPool, rpkt);
     if(nextiface!=0 ){
         return YERRMSG(YAPI_VERSION_MISMATCH,"Device has not been started correctly");
     }
@@ -1382,7 +1388,7 @@ static int yPacketSetup(yPrivDeviceSt *dev,char *errmsg)
         goto error;
     }
     dev->iface.ifaceno = 0;
-    yFree(rpkt);
+    yPoolRelease(&yContext->pktPool, rpkt);
     rpkt = NULL;
 
     if(!YISERR(res=ySendStart(dev,errmsg))){
@@ -1390,7 +1396,7 @@ static int yPacketSetup(yPrivDeviceSt *dev,char *errmsg)
      }
 error:
     if (rpkt) {
-        yFree(rpkt);
+        yPoolRelease(&yContext->pktPool, rpkt);
     }
     //shutdown all previously started interfaces;
     dbglog("Closing partially opened device %s\n",dev->infos.serial);
@@ -1429,7 +1435,7 @@ again:
         if (dev->pktAckDelay > 0) {
             res = yAckPkt(iface, item->pkt.first_stream.pktno, errmsg);
             if (YISERR(res)){
-                yFree(item);
+                yPoolRelease(&yContext->pktPool, item);
                 return res;
             }
         }
@@ -1438,7 +1444,7 @@ again:
 #ifdef DEBUG_DUMP_PKT
             dumpAnyPacket("Drop Late config pkt",iface->ifaceno,&item->pkt);
 #endif
-            yFree(item);
+            yPoolRelease(&yContext->pktPool, item);
             dropcount++;
             if(dropcount >10){
                 dbglog("Too many packets dropped, disable %s\n",dev->infos.serial);
@@ -1448,7 +1454,7 @@ again:
         }
         if (item->pkt.first_stream.pktno == dev->lastpktno) {
             //late retry : drop it since we allready have the packet.
-            yFree(item);
+            yPoolRelease(&yContext->pktPool, item);
             goto again;
         }
 
@@ -1461,7 +1467,7 @@ again:
             return YAPI_SUCCESS;
         } else {
             yPktQueueDup(&iface->rxQueue, nextpktno, __FILE_ID__, __LINE__);
-            yFree(item);
+            yPoolRelease(&yContext->pktPool, item);
             return YERRMSG(YAPI_IO_ERROR, "Missing Packet");
         }
     }
@@ -1518,7 +1524,7 @@ static int yStreamReceived(yPrivDeviceSt *dev, u8 *stream, u8 **data, u8 *size,
     if (dev->curxofs >= USB_PKT_SIZE - sizeof(YSTREAM_Head)) {
         // look if we have the next packet on a interface
         if (dev->currxpkt) {
-            yFree(dev->currxpkt);
+            yPoolRelease(&yContext->pktPool, dev->currxpkt);
             dev->currxpkt=NULL;
         }
         res = yGetNextPktEx(dev, &dev->currxpkt, blockUntilTime, errmsg);
@@ -1821,7 +1827,7 @@ static void yDispatchNotice(yPrivDeviceSt *dev, USB_Notify_Pkt *notify, int pkts
 
 // Timed report packet dispatcher
 //
-static void yDispatchReportV1(yPrivDeviceSt *dev, u8 *data, int pktsize)
+static void yDispatchReportV1(yPrivDeviceSt *dev, u8 *data, int pktsize, u64 rxtime)
 {
     yStrRef serialref = yHashPutStr(dev->infos.serial);
 #ifdef DEBUG_NOTIFICATION
@@ -1833,7 +1839,7 @@ static void yDispatchReportV1(yPrivDeviceSt *dev, u8 *data, int pktsize)
     if(yContext->rawReportCb) {
         yContext->rawReportCb(serialref, (USB_Report_Pkt_V1*) data, pktsize);
     }
-    if (yContext->timedReportCallback) {
+    if (yContext->timedReportCallback || yContext->timedReportExCallback) {
         int  devydx = wpGetDevYdx(serialref);
         if (devydx < 0)
             return;
@@ -1842,20 +1848,16 @@ static void yDispatchReportV1(yPrivDeviceSt *dev, u8 *data, int pktsize)
             int  len = report->extraLen + 1;
             if (report->funYdx == 0xf) {
                 u32 t = data[1] + 0x100u * data[2] + 0x10000u * data[3] + 0x1000000u * data[4];
-                yEnterCriticalSection(&yContext->generic_cs);
-                yContext->generic_infos[devydx].deviceTime = (double)t + data[5] / 250.0;
-                yLeaveCriticalSection(&yContext->generic_cs);
+                yUpdateDeviceTime(devydx, (double)t + data[5] / 250.0, rxtime);
             } else {
                 YAPI_FUNCTION fundesc;
-                double devtime;
+                double devtime, hosttime;
                 Notification_funydx funInfo;
                 funInfo.raw = report->funYdx;
                 ypRegisterByYdx(devydx, funInfo, NULL, &fundesc);
                 data[0] = report->isAvg ? 1 : 0;
-                yEnterCriticalSection(&yContext->generic_cs);
-                devtime = yContext->generic_infos[devydx].deviceTime;
-                yLeaveCriticalSection(&yContext->generic_cs);
-                yFunctionTimedUpdate(fundesc, devtime, data, len + 1);
+                yGetDeviceTime(devydx, &devtime, &hosttime);
+                yFunctionTimedUpdate(fundesc, devtime, hosttime, data, len + 1);
             }
             pktsize -= 1 + len;
             data += 1 + len;
@@ -1865,7 +1867,7 @@ static void yDispatchReportV1(yPrivDeviceSt *dev, u8 *data, int pktsize)
 
 // Timed report packet dispatcher
 //
-static void yDispatchReportV2(yPrivDeviceSt *dev, u8 *data, int pktsize)
+static void yDispatchReportV2(yPrivDeviceSt *dev, u8 *data, int pktsize, u64 rxtime)
 {
     yStrRef serialref = yHashPutStr(dev->infos.serial);
 #ifdef DEBUG_NOTIFICATION
@@ -1877,7 +1879,7 @@ static void yDispatchReportV2(yPrivDeviceSt *dev, u8 *data, int pktsize)
     if(yContext->rawReportV2Cb) {
         yContext->rawReportV2Cb(serialref, (USB_Report_Pkt_V2*) data, pktsize);
     }
-    if (yContext->timedReportCallback) {
+    if (yContext->timedReportCallback || yContext->timedReportExCallback) {
         int  devydx = wpGetDevYdx(serialref);
         if (devydx < 0)
             return;
@@ -1886,20 +1888,16 @@ static void yDispatchReportV2(yPrivDeviceSt *dev, u8 *data, int pktsize)
             int  len = report->extraLen + 1;
             if (report->funYdx == 0xf) {
                 u32 t = data[1] + 0x100u * data[2] + 0x10000u * data[3] + 0x1000000u * data[4];
-                yEnterCriticalSection(&yContext->generic_cs);
-                yContext->generic_infos[devydx].deviceTime = (double)t + data[5] / 250.0;
-                yLeaveCriticalSection(&yContext->generic_cs);
+                yUpdateDeviceTime(devydx, (double)t + data[5] / 250.0, rxtime);
             } else {
                 YAPI_FUNCTION fundesc;
-                double devtime;
+                double devtime, hosttime;
                 Notification_funydx funInfo;
                 funInfo.raw = report->funYdx;
                 ypRegisterByYdx(devydx, funInfo, NULL, &fundesc);
                 data[0] = 2;
-                yEnterCriticalSection(&yContext->generic_cs);
-                devtime = yContext->generic_infos[devydx].deviceTime;
-                yLeaveCriticalSection(&yContext->generic_cs);
-                yFunctionTimedUpdate(fundesc, devtime, data, len + 1);
+                yGetDeviceTime(devydx, &devtime, &hosttime);
+                yFunctionTimedUpdate(fundesc, devtime, hosttime, data, len + 1);
             }
             pktsize -= 1 + len;
             data += 1 + len;
@@ -1966,10 +1964,10 @@ static int yDispatchReceive(yPrivDeviceSt *dev, u64 blockUntilTime, char *errmsg
                 yDispatchNotice(dev, (USB_Notify_Pkt*)data, size, 1);
                 break;
             case YSTREAM_REPORT:
-                yDispatchReportV1(dev, data, size);
+                yDispatchReportV1(dev, data, size, dev->currxpkt->rxtime);
                 break;
             case YSTREAM_REPORT_V2:
-                yDispatchReportV2(dev, data, size);
+                yDispatchReportV2(dev, data, size, dev->currxpkt->rxtime);
                 break;
             case YSTREAM_EMPTY:
             default:
@@ -2456,6 +2454,7 @@ int yUsbFree(yContextSt *ctx,char *errmsg)
         }
         if(p->replybuf) {
             yFree(p->replybuf);
+            yMemUncharge(YAPI_MEM_USB, p->replybufsize);
             p->replybuf = NULL;
         }
         next = p->next;
@@ -1144,9 +1144,17 @@ static int yHTTPMultiSelectReq(struct _RequestSt** reqs, int size, u64 ms, WakeU
                 if (req->replysize >= req->replybufsize - 256) {
                     // need to grow receive buffer
                     int newsize = req->replybufsize << 1;
-                    u8* newbuf = (u8*)yMalloc(newsize);
+                    u8* newbuf;
+                    if (yMemOverLimit(YAPI_MEM_NET, newsize)) {
+                        req->replypos = 0;
+                        req->errcode = YERRMSGTO(YAPI_EXHAUSTED, "Reply exceeds the memory limit", req->errmsg);
+                        yHTTPCloseReqEx(req, 0);
+                        yLeaveCriticalSection(&req->access);
+                        continue;
+                    }
+                    newbuf = (u8*)yBufAlloc(&newsize);
                     memcpy(newbuf, req->replybuf, req->replysize);
-                    yFree(req->replybuf);
+                    yBufRelease(req->replybuf, req->replybufsize);
                     req->replybuf = newbuf;
                     req->replybufsize = newsize;
                 }
@@ -1284,7 +1292,14 @@ static int yWSOpenReqEx(struct _RequestSt* req, int tcpchan, u64 mstimeout, char
     // merge first line and header
     headlen = YSTRLEN(req->headerbuf);
     req->ws.requestsize = headlen + 4 + req->bodysize;
-    req->ws.requestbuf = yMalloc(req->ws.requestsize);
+    if (req->ws.requestbuf && req->ws.requestbufsize < req->ws.requestsize) {
+        yBufRelease(req->ws.requestbuf, req->ws.requestbufsize);
+        req->ws.requestbuf = NULL;
+    }
+    if (req->ws.requestbuf == NULL) {
+        req->ws.requestbufsize = req->ws.requestsize;
+        req->ws.requestbuf = (u8*)yBufAlloc(&req->ws.requestbufsize);
+    }
     p = req->ws.requestbuf;
     memcpy(p, req->headerbuf, headlen);
     p += headlen;
@@ -1339,7 +1354,7 @@ static int yWSSelectReq(struct _RequestSt* req, u64 mstimeout, char* errmsg)
 
     REQLOG("ws_req:%p: select for %d ms %d\n", req, (int)mstimeout, done);
 
-    if (done) {
+    if (done && req->errcode == YAPI_SUCCESS) {
         req->errcode = YAPI_NO_MORE_DATA;
     }
     return YAPI_SUCCESS;
@@ -1469,12 +1484,12 @@ static void dumpTCPReq(const char *fileid, int lineno, struct _RequestSt *req)
 
 struct _RequestSt* yReqAlloc(struct _HubSt* hub)
 {
-    struct _RequestSt* req = yMalloc(sizeof(struct _RequestSt));
+    struct _RequestSt* req = yPoolAlloc(&yContext->reqPool);
     memset(req, 0, sizeof(struct _RequestSt));
     yHashGetUrlPort(hub->url, NULL, NULL, &req->proto, NULL, NULL, NULL);
     TCPLOG("yTcpInitReq %p[%x:%x]\n", req, hub->url, req->proto);
     req->replybufsize = 1500;
-    req->replybuf = (u8*)yMalloc(req->replybufsize);
+    req->replybuf = (u8*)yBufAlloc(&req->replybufsize);
     yInitializeCriticalSection(&req->access);
     yCreateManualEvent(&req->finished, 1);
     req->hub = hub;
@@ -1554,9 +1569,9 @@ int yReqOpen(struct _RequestSt* req, int wait_for_start, int tcpchan, const char
         reqlen = (int)(p - request);
         // Build a request body buffer
         if (req->bodybufsize < bodylen) {
-            if (req->bodybuf) yFree(req->bodybuf);
+            if (req->bodybuf) yBufRelease(req->bodybuf, req->bodybufsize);
             req->bodybufsize = bodylen + (bodylen >> 1);
-            req->bodybuf = (char*)yMalloc(req->bodybufsize);
+            req->bodybuf = (char*)yBufAlloc(&req->bodybufsize);
         }
         memcpy(req->bodybuf, p, bodylen);
         req->bodysize = bodylen;
@@ -1565,9 +1580,9 @@ int yReqOpen(struct _RequestSt* req, int wait_for_start, int tcpchan, const char
     // include space for Connection: close and Authorization: headers
     minlen = reqlen + 400;
     if (req->headerbufsize < minlen) {
-        if (req->headerbuf) yFree(req->headerbuf);
+        if (req->headerbuf) yBufRelease(req->headerbuf, req->headerbufsize);
         req->headerbufsize = minlen + (reqlen >> 1);
-        req->headerbuf = (char*)yMalloc(req->headerbufsize);
+        req->headerbuf = (char*)yBufAlloc(&req->headerbufsize);
     }
     memcpy(req->headerbuf, request, reqlen);
     req->headerbuf[reqlen] = 0;
@@ -1674,7 +1689,7 @@ int yReqRead(struct _RequestSt* req, u8* buffer, int len)
         if (req->replypos + len == req->replysize) {
             req->replypos = 0;
             req->replysize = 0;
-            if (req->proto == PROTO_WEBSOCKET) {
+            if (req->proto == PROTO_WEBSOCKET && req->errcode == YAPI_SUCCESS) {
                 if (req->state == REQ_CLOSED || req->state == REQ_CLOSED_BY_HUB) {
                     req->errcode = YAPI_NO_MORE_DATA;
                 }
@@ -1746,14 +1761,14 @@ void yReqFree(struct _RequestSt* req)
             yTcpClose(req->http.reuseskt);
         }
     } else {
-        if (req->ws.requestbuf) yFree(req->ws.requestbuf);
+        if (req->ws.requestbuf) yBufRelease(req->ws.requestbuf, req->ws.requestbufsize);
     }
-    if (req->headerbuf) yFree(req->headerbuf);
-    if (req->bodybuf) yFree(req->bodybuf);
-    if (req->replybuf) yFree(req->replybuf);
+    if (req->headerbuf) yBufRelease(req->headerbuf, req->headerbufsize);
+    if (req->bodybuf) yBufRelease(req->bodybuf, req->bodybufsize);
+    if (req->replybuf) yBufRelease(req->replybuf, req->replybufsize);
     yCloseEvent(&req->finished);
     yDeleteCriticalSection(&req->access);
-    yFree(req);
+    yPoolRelease(&yContext->reqPool, req);
     //memset(req, 0, sizeof(struct _RequestSt));
 }
 
@@ -2037,14 +2052,22 @@ static int ws_sendAuthenticationMeta(HubSt* hub, char* errmsg)
 
 static void ws_appendTCPData(RequestSt* req, u8* buffer, int pktlen, int isClose)
 {
+    if (req->errcode == YAPI_EXHAUSTED) {
+        // reply already dropped, wait for the end of the request
+        pktlen = 0;
+    } else if (pktlen && req->replybufsize < req->replysize + pktlen && yMemOverLimit(YAPI_MEM_NET, req->replybufsize << 1)) {
+        req->errcode = YERRMSGTO(YAPI_EXHAUSTED, "Reply exceeds the memory limit", req->errmsg);
+        pktlen = 0;
+    }
     if (pktlen) {
         if (req->replybufsize < req->replysize + pktlen) {
             u8* newbuff;
-            req->replybufsize <<= 1;
-            newbuff = yMalloc(req->replybufsize);
+            int newsize = req->replybufsize << 1;
+            newbuff = (u8*)yBufAlloc(&newsize);
             memcpy(newbuff, req->replybuf, req->replysize);
-            yFree(req->replybuf);
+            yBufRelease(req->replybuf, req->replybufsize);
             req->replybuf = newbuff;
+            req->replybufsize = newsize;
         }
 
         memcpy(req->replybuf + req->replysize, buffer, pktlen);
@@ -2095,6 +2118,9 @@ static int ws_parseIncommingFrame(HubSt* hub, u8* buffer, int pktlen, char* errm
 #endif
             yPushFifo(&hub->not_fifo, buffer, pktlen);
             while (handleNetNotification(hub));
+            // callbacks may have been queued by the application layer,
+            // to be run from yapiHandleEvents
+            ySignalEvents();
         }
         break;
     case YSTREAM_EMPTY:
@@ -2699,6 +2725,7 @@ void* ws_thread(void* ctx)
     int continue_processing;
 
 
+    yThreadApplyRole(YAPI_THREAD_HUB);
     yThreadSignalStart(thread);
     WSLOG("hub(%s) start thread \n", hub->name);
 
@@ -3308,6 +3335,7 @@ static void* ySSDP_thread(void* ctx)
     yFifoBuf inFifo;
 
 
+    yThreadApplyRole(YAPI_THREAD_DISCOVERY);
     yThreadSignalStart(thread);
     yFifoInit(&inFifo,buffer,sizeof(buffer));
 
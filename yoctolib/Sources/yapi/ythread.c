@@ -37,7 +37,12 @@
  *
  *********************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// for pthread_setaffinity_np and pthread_setname_np
+#define _GNU_SOURCE
+#endif
 #include "ythread.h"
+#include <string.h>
 #define __FILE_ID__  "ythread"
 
 
@@ -142,8 +147,23 @@ int    yThreadIndex(void)
     }
 }
 
+int    yThreadSetup(const char *name, u64 cpumask, int priority)
+{
+    int res = 0;
+
+    // thread names are not supported by all versions of Windows, skip them
+    if (cpumask && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpumask) == 0) {
+        res = -1;
+    }
+    if (priority > 0 && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        res = -1;
+    }
+    return res;
+}
+
 #else
 #include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 #include <errno.h>
 
@@ -156,70 +176,147 @@ static void initTsdKey()
     pthread_key_create(&yTsdKey, NULL);
 }
 
-void yCreateEvent(yEvent *ev)
+#if defined(__APPLE__)
+// pthread_condattr_setclock is not available, use relative timeouts instead
+#define YEVENT_RELATIVE_WAIT
+#elif defined(CLOCK_MONOTONIC)
+// measure timeouts on the monotonic clock, to be immune to system clock changes
+#define YEVENT_MONOTONIC_WAIT
+#endif
+
+#ifdef YEVENT_RELATIVE_WAIT
+// current time in microseconds, used to compute the remaining time of a wait
+static u64 yEventTimeUs(void)
 {
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000 + (u64)now.tv_nsec / 1000;
+#else
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (u64)now.tv_sec * 1000000 + (u64)now.tv_usec;
+#endif
+}
+#endif
+
+static void yInitEvent(yEvent *ev, int initialState, int autoreset)
+{
+#ifdef YEVENT_MONOTONIC_WAIT
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ev->cond, &attr);
+    pthread_condattr_destroy(&attr);
+#else
     pthread_cond_init(&ev->cond, NULL);
+#endif
     pthread_mutex_init(&ev->mtx, NULL);
-    ev->verif = 0;
-    ev->autoreset = 1;
+    ev->verif = initialState;
+    ev->waiters = 0;
+    ev->autoreset = autoreset;
+}
+
+void yCreateEvent(yEvent *ev)
+{
+    yInitEvent(ev, 0, 1);
 }
 
 void yCreateManualEvent(yEvent *ev, int initialState)
 {
-    pthread_cond_init(&ev->cond, NULL);
-    pthread_mutex_init(&ev->mtx, NULL);
-    ev->verif = initialState > 0;
-    ev->autoreset = 0;
+    yInitEvent(ev, initialState > 0, 0);
 }
 
 void    ySetEvent(yEvent *ev)
 {
+    // verif is set and waiters is read with full-barrier operations, as
+    // waiters is incremented in yWaitForEvent: either the waiter sees verif
+    // set before going to sleep, or we see the waiter and signal it
+    yAtomicCAS32(&ev->verif, 0, 1);
+    if (yAtomicAdd32(&ev->waiters, 0) == 0) {
+        return;
+    }
     pthread_mutex_lock(&ev->mtx);
-    ev->verif = 1;
-    // set verif to 1 because pthread condition seems
-    // to allow conditional wait to exit event if nobody
-    // has set the alarm (see google or linux books of seb)
-    pthread_cond_signal(&ev->cond);
+    if (ev->autoreset) {
+        pthread_cond_signal(&ev->cond);
+    } else {
+        pthread_cond_broadcast(&ev->cond);
+    }
     pthread_mutex_unlock(&ev->mtx);
-
 }
 
 void    yResetEvent(yEvent *ev)
 {
-    pthread_mutex_lock(&ev->mtx);
-    ev->verif = 0;
-    pthread_mutex_unlock(&ev->mtx);
-
+    yAtomicStore32(&ev->verif, 0);
 }
 
+// Return the state of the event, and clear it if it is an auto-reset event
+static int yConsumeEvent(yEvent *ev)
+{
+    if (ev->autoreset) {
+        return yAtomicCAS32(&ev->verif, 1, 0);
+    }
+    return yAtomicLoad32(&ev->verif);
+}
 
 int   yWaitForEvent(yEvent *ev, int time)
 {
     int retval;
+
+    retval = yConsumeEvent(ev);
+    if (retval || time == 0) {
+        return retval;
+    }
     pthread_mutex_lock(&ev->mtx);
-    if (!ev->verif) {
-        if (time >= 0) {
-            struct timeval now;
-            struct timespec later;
-            gettimeofday(&now, NULL);
-            later.tv_sec = now.tv_sec + time / 1000;
-            later.tv_nsec = now.tv_usec * 1000 + (time % 1000) * 1000000;
-            if (later.tv_nsec >= 1000000000) {
-                later.tv_sec++;
-                later.tv_nsec -= 1000000000;
-            }
-            pthread_cond_timedwait(&ev->cond, &ev->mtx, &later);
-        } else {
+    yAtomicAdd32(&ev->waiters, 1);
+    if (time < 0) {
+        while (!yAtomicLoad32(&ev->verif)) {
             pthread_cond_wait(&ev->cond, &ev->mtx);
         }
+    } else if (!yAtomicLoad32(&ev->verif)) {
+        struct timespec later;
+#ifdef YEVENT_RELATIVE_WAIT
+        u64 deadline = yEventTimeUs() + (u64)time * 1000;
+        u64 now;
+        // spurious wakeups wait again for the remaining time
+        while (!yAtomicLoad32(&ev->verif)) {
+            now = yEventTimeUs();
+            if (now >= deadline)
+                break;
+            later.tv_sec = (time_t)((deadline - now) / 1000000);
+            later.tv_nsec = (long)((deadline - now) % 1000000) * 1000;
+            if (pthread_cond_timedwait_relative_np(&ev->cond, &ev->mtx, &later) == ETIMEDOUT)
+                break;
+        }
+#else
+#ifdef YEVENT_MONOTONIC_WAIT
+        clock_gettime(CLOCK_MONOTONIC, &later);
+#else
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        later.tv_sec = now.tv_sec;
+        later.tv_nsec = now.tv_usec * 1000;
+#endif
+        later.tv_sec += time / 1000;
+        later.tv_nsec += (time % 1000) * 1000000;
+        if (later.tv_nsec >= 1000000000) {
+            later.tv_sec++;
+            later.tv_nsec -= 1000000000;
+        }
+        // the deadline is absolute, spurious wakeups simply wait again
+        while (!yAtomicLoad32(&ev->verif)) {
+            if (pthread_cond_timedwait(&ev->cond, &ev->mtx, &later) == ETIMEDOUT)
+                break;
+        }
+#endif
     }
-    retval = ev->verif;
-    if (ev->autoreset)
-        ev->verif = 0;
+    yAtomicAdd32(&ev->waiters, -1);
+    retval = yConsumeEvent(ev);
     pthread_mutex_unlock(&ev->mtx);
     return retval;
-
 }
+
 void   yCloseEvent(yEvent *ev)
 {
     pthread_cond_destroy(&ev->cond);
@@ -276,6 +373,49 @@ int    yThreadIndex(void)
     return res;
 }
 
+int    yThreadSetup(const char *name, u64 cpumask, int priority)
+{
+    int res = 0;
+
+    if (name) {
+#if defined(__APPLE__)
+        pthread_setname_np(name);
+#elif defined(__linux__)
+        pthread_setname_np(pthread_self(), name);
+#endif
+    }
+    if (cpumask) {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        int i;
+
+        CPU_ZERO(&cpus);
+        for (i = 0; i < 64; i++) {
+            if (cpumask & ((u64)1 << i)) {
+                CPU_SET(i, &cpus);
+            }
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            res = -1;
+        }
+#else
+        // macOS has no API to bind a thread to a CPU
+        res = -1;
+#endif
+    }
+    if (priority > 0) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        // requires CAP_SYS_NICE (or root) on Linux
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            res = -1;
+        }
+    }
+    return res;
+}
+
 #endif
 
 
@@ -658,6 +798,27 @@ void yDbgDeleteCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef PROFILE_CRITICAL_SECTION
+// the plain functions below are wrapped by the profiling ones
+#undef yInitializeCriticalSection
+#undef yEnterCriticalSection
+#undef yTryEnterCriticalSection
+#undef yLeaveCriticalSection
+
+typedef struct {
+    volatile u32    state;          // 0: free, 1: being filled, 2: valid
+    const char      *csfile;
+    int             csline;
+    const char      *file;
+    int             line;
+    volatile u32    acquisitions;
+    volatile u32    contended;
+    volatile u64    waitns;
+    volatile u32    maxwaitus;
+    volatile u64    holdns;
+    volatile u32    maxholdus;
+} yCsProfSite;
+#endif
 
 typedef struct {
 #if defined(WINDOWS_API)
@@ -665,6 +826,13 @@ typedef struct {
 #else
     pthread_mutex_t              cs;
 #endif
+#ifdef PROFILE_CRITICAL_SECTION
+    const char                   *fileid;       // where the critical section was initialized
+    int                          lineno;
+    int                          depth;         // recursion depth of the owner
+    yCsProfSite                  *holdsite;     // site of the outermost enter
+    u64                          holdstart;
+#endif
 } yCRITICAL_SECTION_ST;
 
 
@@ -733,6 +901,379 @@ void yDeleteCriticalSection(yCRITICAL_SECTION *cs)
     *cs = NULL;
 }
 
+#ifdef PROFILE_CRITICAL_SECTION
+
+#define YCS_PROF_SITES  1024            // must be a power of two
+
+static yCsProfSite  yCsProfTable[YCS_PROF_SITES];
+static volatile u32 yCsProfLost;        // acquisitions not recorded because the table is full
+
+static u64 yProfGetTimeNs(void)
+{
+#if defined(WINDOWS_API)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&count);
+    return (u64)(count.QuadPart / freq.QuadPart) * 1000000000u +
+        (u64)(count.QuadPart % freq.QuadPart) * 1000000000u / (u64)freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000u + (u64)ts.tv_nsec;
 #endif
+}
 
+static void yProfUpdateMax(volatile u32 *max, u64 ns)
+{
+    u32 us = (ns / 1000 > 0xffffffffu ? 0xffffffffu : (u32)(ns / 1000));
+    u32 old;
+
+    do {
+        old = yAtomicLoad32(max);
+    } while (us > old && !yAtomicCAS32(max, old, us));
+}
 
+static int yProfSiteMatch(yCsProfSite *site, const char *csfile, int csline, const char *fileid, int lineno)
+{
+    return site->line == lineno && site->file == fileid &&
+        site->csline == csline && site->csfile == csfile;
+}
+
+// Find or create the counters of a call site of the lock initialized at
+// csfile:csline, without locking: new entries are claimed with a CAS and
+// published once filled
+static yCsProfSite* yProfGetSite(const char *csfile, int csline, const char *fileid, int lineno)
+{
+    u32 h = (u32)(((size_t)fileid >> 3) * 31 + (u32)lineno) * 0x9e3779b1u;
+    u32 i;
+
+    h ^= (u32)(((size_t)csfile >> 3) * 17 + (u32)csline);
+    for (i = 0; i < YCS_PROF_SITES; i++) {
+        yCsProfSite *site = &yCsProfTable[(h + i) & (YCS_PROF_SITES - 1)];
+        u32 state = yAtomicLoad32(&site->state);
+        if (state == 0 && yAtomicCAS32(&site->state, 0, 1)) {
+            site->csfile = csfile;
+            site->csline = csline;
+            site->file = fileid;
+            site->line = lineno;
+            yAtomicStore32(&site->state, 2);
+            return site;
+        }
+        while ((state = yAtomicLoad32(&site->state)) == 1) {
+            // another thread is filling this entry
+        }
+        if (yProfSiteMatch(site, csfile, csline, fileid, lineno)) {
+            return site;
+        }
+    }
+    yAtomicAdd32(&yCsProfLost, 1);
+    return NULL;
+}
+
+static void yProfAddWait(yCsProfSite *site, u64 wait)
+{
+    if (site) {
+        yAtomicAdd32(&site->contended, 1);
+        yAtomicAdd64(&site->waitns, wait);
+        yProfUpdateMax(&site->maxwaitus, wait);
+    }
+}
+
+static void yProfAddHold(yCsProfSite *site, u64 start)
+{
+    u64 hold = yProfGetTimeNs() - start;
+
+    yAtomicAdd64(&site->holdns, hold);
+    yProfUpdateMax(&site->maxholdus, hold);
+}
+
+static void yProfAcquired(yCRITICAL_SECTION_ST *ycsptr, yCsProfSite *site)
+{
+    if (ycsptr->depth++ == 0) {
+        ycsptr->holdsite = site;
+        ycsptr->holdstart = yProfGetTimeNs();
+    }
+}
+
+void yProfInitializeCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs)
+{
+    yCRITICAL_SECTION_ST *ycsptr;
+
+    yInitializeCriticalSection(cs);
+    ycsptr = (yCRITICAL_SECTION_ST*)(*cs);
+    ycsptr->fileid = fileid;
+    ycsptr->lineno = lineno;
+}
+
+void yProfEnterCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs)
+{
+    yCRITICAL_SECTION_ST *ycsptr = (yCRITICAL_SECTION_ST*)(*cs);
+    yCsProfSite *site = yProfGetSite(ycsptr->fileid, ycsptr->lineno, fileid, lineno);
+
+    if (yTryEnterCriticalSection(cs)) {
+        if (site) {
+            yAtomicAdd32(&site->acquisitions, 1);
+        }
+    } else {
+        u64 start = yProfGetTimeNs();
+        u64 wait;
+        yEnterCriticalSection(cs);
+        wait = yProfGetTimeNs() - start;
+        if (site) {
+            yAtomicAdd32(&site->acquisitions, 1);
+        }
+        yProfAddWait(site, wait);
+    }
+    yProfAcquired(ycsptr, site);
+}
+
+int yProfTryEnterCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs)
+{
+    yCRITICAL_SECTION_ST *ycsptr = (yCRITICAL_SECTION_ST*)(*cs);
+    yCsProfSite *site = yProfGetSite(ycsptr->fileid, ycsptr->lineno, fileid, lineno);
+
+    if (!yTryEnterCriticalSection(cs)) {
+        if (site) {
+            yAtomicAdd32(&site->contended, 1);
+        }
+        return 0;
+    }
+    if (site) {
+        yAtomicAdd32(&site->acquisitions, 1);
+    }
+    yProfAcquired(ycsptr, site);
+    return 1;
+}
+
+void yProfLeaveCriticalSection(const char* fileid, int lineno, yCRITICAL_SECTION *cs)
+{
+    yCRITICAL_SECTION_ST *ycsptr = (yCRITICAL_SECTION_ST*)(*cs);
+
+    // hold times are charged to the site of the outermost enter
+    (void)fileid;
+    (void)lineno;
+    if (--ycsptr->depth == 0 && ycsptr->holdsite) {
+        yProfAddHold(ycsptr->holdsite, ycsptr->holdstart);
+    }
+    yLeaveCriticalSection(cs);
+}
+
+int yCsProfileSnapshot(yCsProfStat *stats, int maxstats, int reset)
+{
+    int i, nb = 0;
+
+    for (i = 0; i < YCS_PROF_SITES; i++) {
+        yCsProfSite *site = &yCsProfTable[i];
+        if (yAtomicLoad32(&site->state) != 2) {
+            continue;
+        }
+        if (nb < maxstats) {
+            stats[nb].csfile = site->csfile;
+            stats[nb].csline = site->csline;
+            stats[nb].file = site->file;
+            stats[nb].line = site->line;
+            stats[nb].acquisitions = yAtomicLoad32(&site->acquisitions);
+            stats[nb].contended = yAtomicLoad32(&site->contended);
+            stats[nb].waitns = yAtomicAdd64(&site->waitns, 0);
+            stats[nb].maxwaitus = yAtomicLoad32(&site->maxwaitus);
+            stats[nb].holdns = yAtomicAdd64(&site->holdns, 0);
+            stats[nb].maxholdus = yAtomicLoad32(&site->maxholdus);
+        }
+        nb++;
+        if (reset) {
+            // counters updated concurrently may be partially lost, which is fine for profiling
+            yAtomicStore32(&site->acquisitions, 0);
+            yAtomicStore32(&site->contended, 0);
+            yAtomicAdd64(&site->waitns, 0 - yAtomicAdd64(&site->waitns, 0));
+            yAtomicStore32(&site->maxwaitus, 0);
+            yAtomicAdd64(&site->holdns, 0 - yAtomicAdd64(&site->holdns, 0));
+            yAtomicStore32(&site->maxholdus, 0);
+        }
+    }
+    return nb;
+}
+
+#endif
+
+#endif
+
+
+#if !defined(MICROCHIP_API)
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PROFILE_CRITICAL_SECTION) && !defined(DEBUG_CRITICAL_SECTION)
+#define PROFILE_RWLOCK
+// the plain functions below are wrapped by the profiling ones
+#undef yInitializeRWLock
+#undef yEnterReadLock
+#undef yLeaveReadLock
+#undef yEnterWriteLock
+#undef yLeaveWriteLock
+#endif
+
+typedef struct {
+#if defined(WINDOWS_API)
+    SRWLOCK                      rw;
+#else
+    pthread_rwlock_t             rw;
+#endif
+#ifdef PROFILE_RWLOCK
+    const char                   *fileid;       // where the lock was initialized
+    int                          lineno;
+    yCsProfSite                  *holdsite;     // site of the writer
+    u64                          holdstart;
+#endif
+} yRWLOCK_ST;
+
+
+void yInitializeRWLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr;
+    yrwptr = (yRWLOCK_ST*)malloc(sizeof(yRWLOCK_ST));
+    memset(yrwptr, 0, sizeof(yRWLOCK_ST));
+#if defined(WINDOWS_API)
+    InitializeSRWLock(&(yrwptr->rw));
+#else
+    pthread_rwlock_init(&(yrwptr->rw), NULL);
+#endif
+    *rw = yrwptr;
+}
+
+void yEnterReadLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+#if defined(WINDOWS_API)
+    AcquireSRWLockShared(&(yrwptr->rw));
+#else
+    pthread_rwlock_rdlock(&(yrwptr->rw));
+#endif
+}
+
+void yLeaveReadLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+#if defined(WINDOWS_API)
+    ReleaseSRWLockShared(&(yrwptr->rw));
+#else
+    pthread_rwlock_unlock(&(yrwptr->rw));
+#endif
+}
+
+void yEnterWriteLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+#if defined(WINDOWS_API)
+    AcquireSRWLockExclusive(&(yrwptr->rw));
+#else
+    pthread_rwlock_wrlock(&(yrwptr->rw));
+#endif
+}
+
+void yLeaveWriteLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+#if defined(WINDOWS_API)
+    ReleaseSRWLockExclusive(&(yrwptr->rw));
+#else
+    pthread_rwlock_unlock(&(yrwptr->rw));
+#endif
+}
+
+void yDeleteRWLock(yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+#if !defined(WINDOWS_API)
+    pthread_rwlock_destroy(&(yrwptr->rw));
+#endif
+    free(*rw);
+    *rw = NULL;
+}
+
+#ifdef PROFILE_RWLOCK
+
+// Read locks can be held by several threads at once, so only their
+// acquisitions and wait times are recorded. Write locks are profiled
+// like critical sections
+void yProfInitializeRWLock(const char* fileid, int lineno, yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr;
+
+    yInitializeRWLock(rw);
+    yrwptr = (yRWLOCK_ST*)(*rw);
+    yrwptr->fileid = fileid;
+    yrwptr->lineno = lineno;
+}
+
+void yProfEnterReadLock(const char* fileid, int lineno, yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+    yCsProfSite *site = yProfGetSite(yrwptr->fileid, yrwptr->lineno, fileid, lineno);
+    int acquired;
+
+#if defined(WINDOWS_API)
+    acquired = TryAcquireSRWLockShared(&(yrwptr->rw));
+#else
+    acquired = (pthread_rwlock_tryrdlock(&(yrwptr->rw)) == 0);
+#endif
+    if (!acquired) {
+        u64 start = yProfGetTimeNs();
+        yEnterReadLock(rw);
+        yProfAddWait(site, yProfGetTimeNs() - start);
+    }
+    if (site) {
+        yAtomicAdd32(&site->acquisitions, 1);
+    }
+}
+
+void yProfLeaveReadLock(const char* fileid, int lineno, yRWLOCK *rw)
+{
+    (void)fileid;
+    (void)lineno;
+    yLeaveReadLock(rw);
+}
+
+void yProfEnterWriteLock(const char* fileid, int lineno, yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+    yCsProfSite *site = yProfGetSite(yrwptr->fileid, yrwptr->lineno, fileid, lineno);
+    int acquired;
+
+#if defined(WINDOWS_API)
+    acquired = TryAcquireSRWLockExclusive(&(yrwptr->rw));
+#else
+    acquired = (pthread_rwlock_trywrlock(&(yrwptr->rw)) == 0);
+#endif
+    if (!acquired) {
+        u64 start = yProfGetTimeNs();
+        yEnterWriteLock(rw);
+        yProfAddWait(site, yProfGetTimeNs() - start);
+    }
+    if (site) {
+        yAtomicAdd32(&site->acquisitions, 1);
+    }
+    yrwptr->holdsite = site;
+    yrwptr->holdstart = yProfGetTimeNs();
+}
+
+void yProfLeaveWriteLock(const char* fileid, int lineno, yRWLOCK *rw)
+{
+    yRWLOCK_ST *yrwptr = (yRWLOCK_ST*)(*rw);
+
+    (void)fileid;
+    (void)lineno;
+    if (yrwptr->holdsite) {
+        yProfAddHold(yrwptr->holdsite, yrwptr->holdstart);
+    }
+    yLeaveWriteLock(rw);
+}
+
+#endif
+
+#endif
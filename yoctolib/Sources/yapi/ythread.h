@@ -61,7 +61,8 @@ typedef HANDLE yEvent;
 typedef struct {
     pthread_cond_t   cond;
     pthread_mutex_t  mtx;
-    int              verif;
+    volatile int     verif;         // event state, set and cleared atomically
+    volatile int     waiters;       // threads blocked on cond, ySetEvent only signals if > 0
     int              autoreset;
 } yEvent;
 
@@ -75,6 +76,38 @@ int    yWaitForEvent(yEvent *ev,int time);
 void   yCloseEvent(yEvent *ev);
 
 
+/*********************************************************************
+ * ATOMIC OPERATIONS
+ *
+ * Loads have acquire semantics, stores have release semantics and
+ * read-modify-write operations are full barriers.
+ *********************************************************************/
+
+#if defined(WINDOWS_API) && (defined(_MSC_VER) || defined(__BORLANDC__))
+#define yAtomicLoad32(ptr)              ((u32)InterlockedCompareExchange((volatile LONG*)(ptr), 0, 0))
+#define yAtomicStore32(ptr,val)         ((void)InterlockedExchange((volatile LONG*)(ptr), (LONG)(val)))
+#define yAtomicAdd32(ptr,val)           ((u32)(InterlockedExchangeAdd((volatile LONG*)(ptr), (LONG)(val)) + (LONG)(val)))
+#define yAtomicLoad64(ptr)              ((u64)InterlockedCompareExchange64((volatile LONGLONG*)(ptr), 0, 0))
+#define yAtomicStore64(ptr,val)         ((void)InterlockedExchange64((volatile LONGLONG*)(ptr), (LONGLONG)(val)))
+#define yAtomicAdd64(ptr,val)           ((u64)(InterlockedExchangeAdd64((volatile LONGLONG*)(ptr), (LONGLONG)(val)) + (LONGLONG)(val)))
+#define yAtomicCAS32(ptr,oldval,newval) (InterlockedCompareExchange((volatile LONG*)(ptr), (LONG)(newval), (LONG)(oldval)) == (LONG)(oldval))
+#define yAtomicLoadPtr(ptr)             InterlockedCompareExchangePointer((PVOID volatile*)(ptr), NULL, NULL)
+#define yAtomicStorePtr(ptr,val)        ((void)InterlockedExchangePointer((PVOID volatile*)(ptr), (PVOID)(val)))
+#define yAtomicCASPtr(ptr,oldval,newval) (InterlockedCompareExchangePointer((PVOID volatile*)(ptr), (PVOID)(newval), (PVOID)(oldval)) == (PVOID)(oldval))
+#else
+#define yAtomicLoad32(ptr)              __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define yAtomicStore32(ptr,val)         __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define yAtomicAdd32(ptr,val)           __atomic_add_fetch((ptr), (val), __ATOMIC_SEQ_CST)
+#define yAtomicLoad64(ptr)              __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define yAtomicStore64(ptr,val)         __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define yAtomicAdd64(ptr,val)           __atomic_add_fetch((ptr), (val), __ATOMIC_SEQ_CST)
+#define yAtomicCAS32(ptr,oldval,newval) __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#define yAtomicLoadPtr(ptr)             __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define yAtomicStorePtr(ptr,val)        __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define yAtomicCASPtr(ptr,oldval,newval) __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#endif
+
+
 /*********************************************************************
  * THREAD FUNCTION 
  *********************************************************************/
@@ -113,6 +146,33 @@ void   yThreadRequestEnd(yThread *yth);
 int    yThreadMustEnd(yThread *yth);
 void   yThreadKill(yThread *yth);
 int    yThreadIndex(void);
+// Name the calling thread, bind it to the CPUs of cpumask (0 for any CPU) and,
+// if priority > 0, switch it to real-time scheduling (SCHED_FIFO). Returns -1
+// if the affinity or the scheduling policy could not be applied
+int    yThreadSetup(const char *name, u64 cpumask, int priority);
+
+#ifdef PROFILE_CRITICAL_SECTION
+// Lock contention counters of one call site of one critical section or
+// reader/writer lock. Locks are identified by the place where they are
+// initialized, so that per-object locks (per hub, per device) are aggregated.
+// Hold times are not measured for read locks
+typedef struct {
+    const char  *csfile;        // where the lock was initialized
+    int         csline;
+    const char  *file;          // where it was entered
+    int         line;
+    u32         acquisitions;
+    u32         contended;      // acquisitions that had to wait, and failed try-enters
+    u64         waitns;         // total time spent waiting for the lock
+    u32         maxwaitus;
+    u64         holdns;         // total time the lock was held (outermost enter to leave)
+    u32         maxholdus;
+} yCsProfStat;
+
+// Copy the counters of up to maxstats call sites, and optionally reset them.
+// Returns the number of call sites recorded so far
+int    yCsProfileSnapshot(yCsProfStat *stats, int maxstats, int reset);
+#endif
 
 #ifdef  __cplusplus
 }
@@ -800,6 +800,7 @@ typedef void (*HTTPRequestCallback)(YDevice *device,NSMutableDictionary *context
     YDEV_DESCR      _devdescr;
     u64             _cacheStamp;
     NSString*       _cacheJson;
+    yJsonIndex      _cacheIndex;
     NSArray*        _functions;
     char            _rootdevice[YOCTO_SERIAL_LEN];
     char           *_subpath;
@@ -812,6 +813,7 @@ typedef void (*HTTPRequestCallback)(YDevice *device,NSMutableDictionary *context
 -(YRETCODE)     HTTPRequestAsync:(NSString*)request :(HTTPRequestCallback)callback :(NSMutableDictionary*)context :(NSError**)error;
 -(YRETCODE)     HTTPRequest:(NSString*)request :(NSMutableData**)buffer :(NSError**)error;
 -(YRETCODE)     requestAPI:(NSString**)apires :(NSError**)error;
+-(const yJsonIndex*) apiIndex;
 -(void)         clearCache;
 -(YRETCODE)     getFunctions:(NSArray**)functions :(NSError**)error;
 @end
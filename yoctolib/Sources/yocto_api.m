@@ -243,6 +243,15 @@ static NSMutableDictionary* YFunctions_cache = nil;
 
 
 
+// value and timed report forwarders may run in parallel on the callback
+// threads of yapiSetCallbackThreads, so the data event queue has its own lock
+static void yPushDataEvent(YapiEvent *ev)
+{
+    @synchronized(YAPI_data_events) {
+        [YAPI_data_events addObject:ev];
+    }
+}
+
 static yLogCallback YAPI_logFunction=NULL;
 static void yapiLogFunctionFwd(const char *clog,u32 loglen)
 {
@@ -291,7 +300,7 @@ static void yapiDeviceArrivalCallbackFwd(YAPI_DEVICE devdescr)
             for (id it in _ValueCallbackList) {
                 if ([it functionDescriptor] == Y_FUNCTIONDESCRIPTOR_INVALID){
                     ev =[[YapiEvent alloc] initFunction:it withEvent:YAPI_FUN_REFRESH];
-                    [YAPI_data_events addObject:ev];
+                    yPushDataEvent(ev);
                     ARC_release(ev);
                 }
             }
@@ -346,7 +355,7 @@ static void yapiDeviceConfigChangeCallbackFwd(YAPI_DEVICE devdescr)
         if(YISERR(yapiGetDeviceInfo(devdescr,&infos,NULL))) return;
         module = yFindModule([STR_y2oc(infos.serial) stringByAppendingFormat:@".module"]);
         ev =[[YapiEvent alloc] initDeviceEvent:YAPI_DEV_CONFCHANGE forModule:module];
-        [YAPI_data_events addObject:ev];
+        yPushDataEvent(ev);
         ARC_release(ev);
     }
 }
@@ -377,7 +386,7 @@ static void yInternalPushNewVal(YAPI_FUNCTION fundescr,NSString * value)
             }else{
                 ev =[[YapiEvent alloc] initFunction:it newValue:value];
             }
-            [YAPI_data_events addObject:ev];
+            yPushDataEvent(ev);
             ARC_release(ev);
         }
     }
@@ -407,7 +416,7 @@ static void yapiTimedReportCallbackFwd(YAPI_FUNCTION fundescr,double timestamp,
                 [report addObject:[NSNumber numberWithUnsignedShort:bytes[i]]];
             }
             ev =[[YapiEvent alloc] initWithSensor:it AndTimestamp:timestamp AndReport:report];
-            [YAPI_data_events addObject:ev];
+            yPushDataEvent(ev);
             ARC_release(ev);
         }
     }
@@ -1325,17 +1334,18 @@ static const char* hexArray = "0123456789ABCDEF";
         return res;
     }
     // pop data event and call user callback
-    while([YAPI_data_events count] >0){
-        YapiEvent       *ev;
-        yapiLockFunctionCallBack(NULL);
-        if ([YAPI_data_events count] ==0){
-            yapiUnlockFunctionCallBack(NULL);
+    while(1){
+        YapiEvent       *ev = nil;
+        @synchronized(YAPI_data_events) {
+            if ([YAPI_data_events count] > 0){
+                ev = [YAPI_data_events objectAtIndex:0];
+                ARC_retain(ev);
+                [YAPI_data_events removeObjectAtIndex:0];
+            }
+        }
+        if (ev == nil) {
             break;
         }
-        ev = [YAPI_data_events objectAtIndex:0];
-        ARC_retain(ev);
-        [YAPI_data_events removeObjectAtIndex:0];
-        yapiUnlockFunctionCallBack(NULL);
         [ev invokeFunctionEvent];
         ARC_release(ev);
 
@@ -1674,6 +1684,7 @@ static const char* hexArray = "0123456789ABCDEF";
     _devdescr    = devdesc;
     _cacheJson   = @"";
     _cacheStamp  = 0;
+    memset(&_cacheIndex, 0, sizeof(_cacheIndex));
     _functions   = nil;
     return self;
 
@@ -1692,6 +1703,7 @@ static const char* hexArray = "0123456789ABCDEF";
         _subpath =NULL;
     }
     ARC_release(_cacheJson);
+    yJsonIndexFree(&_cacheIndex);
     ARC_dealloc(super);
 }
 
@@ -1889,16 +1901,29 @@ static const char* hexArray = "0123456789ABCDEF";
     _cacheJson = *apires;
     ARC_retain(_cacheJson);
     _cacheStamp = [YAPI GetTickCount] + [YAPI DefaultCacheValidity];
+    // index the reply once, so that each function can find its own subtree directly
+    if(yJsonIndexBuild(&_cacheIndex, j.src, (int)strlen(j.src)) < 0) {
+        _cacheIndex.count = 0;
+    }
 
     return YAPI_SUCCESS;
 }
 
 
+// Returns the index of the cached API string, or NULL if it could not be indexed
+-(const yJsonIndex*) apiIndex
+{
+    if(_cacheIndex.count == 0) return NULL;
+    return &_cacheIndex;
+}
+
+
 -(void)   clearCache
 {
     _cacheStamp = 0;
     ARC_release(_cacheJson);
     _cacheJson =nil;
+    _cacheIndex.count = 0;
 }
 
 -(YRETCODE)   getFunctions:(NSArray**)functions :(NSError**)error
@@ -2115,8 +2140,18 @@ static const char* hexArray = "0123456789ABCDEF";
 
 -(NSString*)     _parseString:(yJsonStateMachine*) j
 {
-    NSString*  res = STR_y2oc(j->token);
+    NSString*  res;
+    yJsonSlice slice;
 
+    if(j->st == YJSON_PARSE_STRING && yJsonStringSlice(j, &slice)) {
+        if(!slice.escaped) {
+            return ARC_sendAutorelease([[NSString alloc] initWithBytes:slice.ptr length:slice.len encoding:NSISOLatin1StringEncoding]);
+        }
+        NSMutableData *decoded = [NSMutableData dataWithLength:slice.len];
+        int len = yJsonUnescape(slice.ptr, slice.len, (char*)[decoded mutableBytes], slice.len);
+        return ARC_sendAutorelease([[NSString alloc] initWithBytes:[decoded bytes] length:len encoding:NSISOLatin1StringEncoding]);
+    }
+    res = STR_y2oc(j->token);
     while(j->next == YJSON_PARSE_STRINGCONT && yJsonParse(j) == YJSON_PARSE_AVAIL) {
         res =[res stringByAppendingString: STR_y2oc(j->token)];
     }
@@ -3033,6 +3068,9 @@ static const char* hexArray = "0123456789ABCDEF";
     YDevice     *dev;
     NSError     *error;
     NSString    *apires;
+    const char  *json;
+    const yJsonIndex *index;
+    int         node;
     YFUN_DESCR  fundescr;
     YRETCODE    res;
     char        errbuf[YOCTO_ERRMSG_LEN];
@@ -3074,8 +3112,22 @@ static const char* hexArray = "0123456789ABCDEF";
     _hwId = [NSString stringWithFormat:@"%@.%@",_serial,_funId];
     ARC_retain(_hwId);
 
-    // Parse JSON data for the device and locate our function in it
-    j.src = STR_oc2y(apires);
+    // Locate our function in the indexed JSON data of the device
+    json = STR_oc2y(apires);
+    index = [dev apiIndex];
+    if(index) {
+        node = yJsonIndexMember(index, json, 0, funcId, (int)strlen(funcId));
+        if(node >= 0 && index->nodes[node].type == YJSON_PARSE_STRUCT) {
+            j.src = json + index->nodes[node].start;
+            j.end = json + index->nodes[node].end;
+            j.st = YJSON_START;
+            [self _parse:&j];
+        }
+        return YAPI_SUCCESS;
+    }
+
+    // No index available, parse JSON data for the device and locate our function in it
+    j.src = json;
     j.end = j.src + strlen(j.src);
     j.st = YJSON_START;
     if(yJsonParse(&j) != YJSON_PARSE_AVAIL || j.st != YJSON_PARSE_STRUCT) {